@@ -1,73 +1,203 @@
 #ifndef PERF_LOGGER_HPP
 #define PERF_LOGGER_HPP
 
-#include <string>
-#include <fstream>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <string>
 
+// Per-frame timing log.
+//
+// Every thread that logs gets its own lock-free ring of fixed-size binary
+// records (registered on its first record). A background writer drains
+// all rings into a binary log every few ms, so the hot path is a clock
+// read (vDSO, no syscall) and a store into the ring: no lock, no
+// formatting, no I/O. A full ring drops records and counts them, it never
+// blocks the logging thread.
+//
+// tools/perf2csv turns the log back into the frame_id,t_cam,...,ran_infer
+// CSV, plus the named marks, values and spans in a second CSV.
 namespace perf_detail {
     using clk = std::chrono::steady_clock;
-    inline double now_s() {
-        return std::chrono::duration<double>(clk::now().time_since_epoch()).count();
+    inline uint64_t now_ns() {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   clk::now().time_since_epoch()).count();
     }
-    struct FrameRec {
-        int    id = -1;
-        double t_cam = 0, t_pp = 0, t_det_s = 0, t_det_e = 0, t_dec = 0, t_aud = 0;
-        int    ran_infer = 0;
+    inline uint64_t s_to_ns(double s) { return s > 0.0 ? (uint64_t)(s * 1e9 + 0.5) : 0; }
+
+    //  log format
+    // 16-byte header (magic, version, record size), then Records. Text of
+    // a name comes in a REC_NAME record before the first record using it.
+    static const char     kMagic[8]  = { 'P', 'E', 'R', 'F', 'L', 'O', 'G', '\0' };
+    static const uint32_t kVersion   = 1;
+
+    enum RecType : uint8_t {
+        REC_NAME = 1,   // name id -> text in the 24 bytes of t_ns/frame/aux
+        REC_MARK,       // point in time t_ns
+        REC_SPAN,       // starts at t_ns, aux = duration ns
+        REC_VALUE,      // aux = value
+        REC_COMMIT,     // frame complete, one CSV row
+        REC_DROPPED,    // aux = records dropped so far by this thread's ring
+    };
+
+    struct Record {
+        uint64_t t_ns;
+        int64_t  frame;    // -1 outside a frame
+        uint64_t aux;
+        uint16_t name;
+        uint16_t thread;
+        uint8_t  type;
+        uint8_t  pad[3];
+    };
+    static_assert(sizeof(Record) == 32, "Record is the on-disk format");
+
+    // names known to the CSV columns, always interned with these ids
+    enum FixedName : uint16_t {
+        N_T_CAM = 0, N_T_PP, N_T_DET_S, N_T_DET_E, N_T_DEC, N_T_AUD, N_RAN_INFER, N_FIXED
     };
-    class Logger {
+
+    //  per-thread ring
+    // Single producer (the owning thread), single consumer (the writer).
+    class Ring {
     public:
-        Logger() = default;
-        void init(const std::string& path) {
-            if (ofs_.is_open()) return;
+        static const uint64_t kSize = 8192;   // records, power of two
 
-            ofs_.open(path, std::ios::out | std::ios::app);
-            if (!ofs_) return;
+        explicit Ring(uint16_t thread) : thread_(thread) {}
 
-            // chỉ ghi header nếu file đang rỗng
-            if (ofs_.tellp() == 0) {
-                ofs_ << "frame_id,t_cam,t_pp,t_det_s,t_det_e,t_dec,t_aud,ran_infer\n";
-                ofs_.flush();
+        uint16_t thread() const { return thread_; }
+
+        void push(const Record& r) {
+            const uint64_t t = tail_.load(std::memory_order_relaxed);
+            if (t - head_.load(std::memory_order_acquire) == kSize) {
+                dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                               std::memory_order_relaxed);
+                return;
             }
+            buf_[t & (kSize - 1)] = r;
+            tail_.store(t + 1, std::memory_order_release);
         }
-        void begin(int frame_id) { cur_ = {}; cur_.id = frame_id; }
-        void mark_cam()   { cur_.t_cam   = now_s(); }
-        void mark_pp()    { cur_.t_pp    = now_s(); }
-        void mark_det_s() { cur_.t_det_s = now_s(); }
-        void mark_det_e() { cur_.t_det_e = now_s(); }
-        void mark_dec()   { cur_.t_dec   = now_s(); }
-        void mark_aud()   { cur_.t_aud   = now_s(); }
-        void set_ran_infer(bool ran) { cur_.ran_infer = ran ? 1 : 0; }
-        void commit() {
-            if (!ofs_) return;
-            ofs_ << cur_.id << "," << cur_.t_cam << "," << cur_.t_pp << ","
-                 << cur_.t_det_s << "," << cur_.t_det_e << ","
-                 << cur_.t_dec   << "," << cur_.t_aud  << ","
-                 << cur_.ran_infer << "\n";
-            ofs_.flush();
+
+        // writer side
+        size_t pop(Record* out, size_t max) {
+            const uint64_t h = head_.load(std::memory_order_relaxed);
+            const uint64_t t = tail_.load(std::memory_order_acquire);
+            size_t n = (size_t)(t - h);
+            if (n > max) n = max;
+            for (size_t i = 0; i < n; i++)
+                out[i] = buf_[(h + i) & (kSize - 1)];
+            head_.store(h + n, std::memory_order_release);
+            return n;
         }
+        uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
     private:
-        std::ofstream ofs_;
-        FrameRec cur_;
+        // head and tail a cache line apart, the two sides don't share one
+        const uint16_t        thread_;
+        std::atomic<uint64_t> head_{0};      // writer
+        char                  pad0_[64];
+        std::atomic<uint64_t> tail_{0};      // owner
+        std::atomic<uint64_t> dropped_{0};   // owner writes, writer reads
+        char                  pad1_[64];
+        Record                buf_[kSize];
+    };
+
+    // perf_logger.cpp; each runs once per thread / call site, not per record
+    Ring*    register_thread();
+    uint16_t intern(const char* name);
+    void     init(const std::string& path);
+    void     shutdown();   // final drain + close, also run at exit
+
+    struct ThreadCtx {
+        Ring*   ring  = nullptr;
+        int64_t frame = -1;
     };
+    inline ThreadCtx& ctx() {
+        static thread_local ThreadCtx c;
+        if (!c.ring) c.ring = register_thread();
+        return c;
+    }
+
+    inline void emit(uint8_t type, uint16_t name, uint64_t t_ns, uint64_t aux) {
+        ThreadCtx& c = ctx();
+        Record r;
+        r.t_ns   = t_ns;
+        r.frame  = c.frame;
+        r.aux    = aux;
+        r.name   = name;
+        r.thread = c.ring->thread();
+        r.type   = type;
+        r.pad[0] = r.pad[1] = r.pad[2] = 0;
+        c.ring->push(r);
+    }
+
+    inline void begin(int64_t frame_id) { ctx().frame = frame_id; }
+    inline void mark(uint16_t name)     { emit(REC_MARK, name, now_ns(), 0); }
+    inline void mark_at(uint16_t name, double t_s) {
+        if (t_s > 0.0) emit(REC_MARK, name, s_to_ns(t_s), 0);   // 0 = not reached, as in the CSV
+    }
+    inline void value(uint16_t name, uint64_t v) { emit(REC_VALUE, name, now_ns(), v); }
+    // a stamp for another frame than this thread's current one (audio start, after commit)
+    inline void mark_frame_at(uint16_t name, int64_t frame_id, double t_s) {
+        ThreadCtx& c = ctx();
+        const int64_t cur = c.frame;
+        c.frame = frame_id;
+        mark_at(name, t_s);
+        c.frame = cur;
+    }
+    inline void commit() {
+        emit(REC_COMMIT, 0, now_ns(), 0);
+        ctx().frame = -1;
+    }
+    // stamps taken on another thread (detector pool workers), seconds on steady_clock
+    inline void set_det_times(double t_cam, double t_pp, double t_det_s, double t_det_e) {
+        mark_at(N_T_CAM, t_cam);
+        mark_at(N_T_PP, t_pp);
+        mark_at(N_T_DET_S, t_det_s);
+        mark_at(N_T_DET_E, t_det_e);
+    }
 
-    inline Logger& singleton() { static Logger L; return L; }
+    // scope timer, one REC_SPAN at the end of the scope
+    class Span {
+    public:
+        explicit Span(uint16_t name) : name_(name), t0_(now_ns()) {}
+        ~Span() { emit(REC_SPAN, name_, t0_, now_ns() - t0_); }
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    private:
+        uint16_t name_;
+        uint64_t t0_;
+    };
 } // namespace perf_detail
 
+#define PERF_CAT_(a, b) a##b
+#define PERF_CAT(a, b)  PERF_CAT_(a, b)
+
 #ifdef PERF_ENABLE
-    #define PERF_INIT(path)           do{ perf_detail::singleton().init(path); }while(0)
-    #define PERF_FRAME_BEGIN(id)      do{ perf_detail::singleton().begin((id)); }while(0)
-    #define PERF_MARK_CAM()           do{ perf_detail::singleton().mark_cam(); }while(0)
-    #define PERF_MARK_PP()            do{ perf_detail::singleton().mark_pp(); }while(0)
-    #define PERF_MARK_DET_S()         do{ perf_detail::singleton().mark_det_s(); }while(0)
-    #define PERF_MARK_DET_E()         do{ perf_detail::singleton().mark_det_e(); }while(0)
-    #define PERF_MARK_DEC()           do{ perf_detail::singleton().mark_dec(); }while(0)
-    #define PERF_MARK_AUD()           do{ perf_detail::singleton().mark_aud(); }while(0)
-    #define PERF_SET_RAN_INFER(b)     do{ perf_detail::singleton().set_ran_infer((b)); }while(0)
-    #define PERF_FRAME_COMMIT()       do{ perf_detail::singleton().commit(); }while(0)
+    #define PERF_INIT(path)           do{ perf_detail::init(path); }while(0)
+    #define PERF_SHUTDOWN()           do{ perf_detail::shutdown(); }while(0)
+    #define PERF_FRAME_BEGIN(id)      do{ perf_detail::begin((id)); }while(0)
+    #define PERF_MARK_CAM()           do{ perf_detail::mark(perf_detail::N_T_CAM); }while(0)
+    #define PERF_MARK_PP()            do{ perf_detail::mark(perf_detail::N_T_PP); }while(0)
+    #define PERF_MARK_DET_S()         do{ perf_detail::mark(perf_detail::N_T_DET_S); }while(0)
+    #define PERF_MARK_DET_E()         do{ perf_detail::mark(perf_detail::N_T_DET_E); }while(0)
+    #define PERF_MARK_DEC()           do{ perf_detail::mark(perf_detail::N_T_DEC); }while(0)
+    #define PERF_MARK_AUD()           do{ perf_detail::mark(perf_detail::N_T_AUD); }while(0)
+    #define PERF_MARK_AUD_AT(id, t)   do{ perf_detail::mark_frame_at(perf_detail::N_T_AUD, (id), (t)); }while(0)
+    #define PERF_SET_RAN_INFER(b)     do{ perf_detail::value(perf_detail::N_RAN_INFER, (b) ? 1 : 0); }while(0)
+    #define PERF_SET_DET_TIMES(c,p,s,e) do{ perf_detail::set_det_times((c),(p),(s),(e)); }while(0)
+    #define PERF_FRAME_COMMIT()       do{ perf_detail::commit(); }while(0)
+    // named events; name must be a string literal (interned once per call site)
+    #define PERF_MARK(name)           do{ static const uint16_t perf_id_ = perf_detail::intern(name); \
+                                          perf_detail::mark(perf_id_); }while(0)
+    #define PERF_VALUE(name, v)       do{ static const uint16_t perf_id_ = perf_detail::intern(name); \
+                                          perf_detail::value(perf_id_, (uint64_t)(v)); }while(0)
+    #define PERF_SPAN(name) \
+        static const uint16_t PERF_CAT(perf_span_id_, __LINE__) = perf_detail::intern(name); \
+        perf_detail::Span PERF_CAT(perf_span_, __LINE__)(PERF_CAT(perf_span_id_, __LINE__))
 #else
     // no-op macros when PERF_ENABLE not defined
     #define PERF_INIT(path)           do{}while(0)
+    #define PERF_SHUTDOWN()           do{}while(0)
     #define PERF_FRAME_BEGIN(id)      do{}while(0)
     #define PERF_MARK_CAM()           do{}while(0)
     #define PERF_MARK_PP()            do{}while(0)
@@ -75,8 +205,13 @@ namespace perf_detail {
     #define PERF_MARK_DET_E()         do{}while(0)
     #define PERF_MARK_DEC()           do{}while(0)
     #define PERF_MARK_AUD()           do{}while(0)
+    #define PERF_MARK_AUD_AT(id, t)   do{}while(0)
     #define PERF_SET_RAN_INFER(b)     do{}while(0)
+    #define PERF_SET_DET_TIMES(c,p,s,e) do{}while(0)
     #define PERF_FRAME_COMMIT()       do{}while(0)
+    #define PERF_MARK(name)           do{}while(0)
+    #define PERF_VALUE(name, v)       do{}while(0)
+    #define PERF_SPAN(name)           do{}while(0)
 #endif
 
-#endif  
\ No newline at end of file
+#endif
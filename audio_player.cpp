@@ -1,41 +1,382 @@
 #include "audio_player.hpp"
 
-#include <sys/time.h>
-#include <cstdlib>
-#include <thread>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
 
-AudioPlayer::AudioPlayer(const std::string& file_path,
-                         int throttle_ms)
-    : file(file_path)
-    , throttle(throttle_ms)
-    , last_ms(0)
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+bool parse_audio_sink(const std::string& spec, AudioConfig& cfg)
 {
+    if (spec == "null") {
+        cfg.sink = AudioConfig::SINK_NULL;
+    } else if (spec == "alsa") {
+        cfg.sink = AudioConfig::SINK_ALSA;
+        cfg.device = "default";
+    } else if (spec.compare(0, 5, "alsa:") == 0 && spec.size() > 5) {
+        cfg.sink = AudioConfig::SINK_ALSA;
+        cfg.device = spec.substr(5);
+    } else if (spec.compare(0, 5, "file:") == 0 && spec.size() > 5) {
+        cfg.sink = AudioConfig::SINK_FILE;
+        cfg.device = spec.substr(5);
+    } else {
+        return false;
+    }
+    return true;
 }
 
-long long AudioPlayer::now_ms() const
+//  sinks
+// write() takes one period and returns when the sink can take the next
+// (device buffer has room / real time has caught up); delay() is the number
+// of frames written earlier that play before the next write.
+class AudioPlayer::Sink
+{
+public:
+    virtual ~Sink() {}
+    virtual bool write(const int16_t* pcm, int frames) = 0;
+    virtual long delay() { return 0; }
+};
+
+namespace {
+
+// paced by the clock like a device, nothing is output
+class NullSink : public AudioPlayer::Sink
+{
+public:
+    explicit NullSink(int rate) : rate_(rate) {}
+
+    bool write(const int16_t*, int frames) override
+    {
+        const auto period = std::chrono::microseconds(1000000LL * frames / rate_);
+        const auto now = AudioPlayer::clock::now();
+        if (next_ < now - period * 4)
+            next_ = now;   // first write or fell far behind: restart the clock
+        next_ += period;
+        std::this_thread::sleep_until(next_);
+        return true;
+    }
+
+protected:
+    int rate_;
+private:
+    AudioPlayer::clock::time_point next_;
+};
+
+// everything that would have been played, silence included, as a WAV file
+class FileSink : public NullSink
+{
+public:
+    FileSink(FILE* f, int rate, int channels) : NullSink(rate), f_(f), channels_(channels)
+    {
+        header(0);
+    }
+
+    ~FileSink() override
+    {
+        std::fseek(f_, 0, SEEK_SET);
+        header(bytes_);
+        std::fclose(f_);
+    }
+
+    bool write(const int16_t* pcm, int frames) override
+    {
+        const size_t n = (size_t)frames * channels_;
+        if (std::fwrite(pcm, sizeof(int16_t), n, f_) != n)
+            return false;
+        bytes_ += (uint32_t)(n * sizeof(int16_t));
+        return NullSink::write(pcm, frames);
+    }
+
+private:
+    void header(uint32_t data_bytes)
+    {
+        const uint32_t rate = (uint32_t)rate_, byte_rate = rate * channels_ * 2, riff = 36 + data_bytes;
+        const uint32_t fmt_len = 16;
+        const uint16_t fmt = 1, ch = (uint16_t)channels_, align = (uint16_t)(channels_ * 2), bits = 16;
+        std::fwrite("RIFF", 1, 4, f_);  std::fwrite(&riff, 4, 1, f_);
+        std::fwrite("WAVEfmt ", 1, 8, f_);
+        std::fwrite(&fmt_len, 4, 1, f_); std::fwrite(&fmt, 2, 1, f_);   std::fwrite(&ch, 2, 1, f_);
+        std::fwrite(&rate, 4, 1, f_);    std::fwrite(&byte_rate, 4, 1, f_);
+        std::fwrite(&align, 2, 1, f_);   std::fwrite(&bits, 2, 1, f_);
+        std::fwrite("data", 1, 4, f_);   std::fwrite(&data_bytes, 4, 1, f_);
+    }
+    FILE*    f_;
+    int      channels_;
+    uint32_t bytes_ = 0;
+};
+
+#ifdef HAVE_ALSA
+class AlsaSink : public AudioPlayer::Sink
+{
+public:
+    AlsaSink(snd_pcm_t* pcm, int channels) : pcm_(pcm), channels_(channels) {}
+    ~AlsaSink() override
+    {
+        snd_pcm_drain(pcm_);
+        snd_pcm_close(pcm_);
+    }
+
+    bool write(const int16_t* pcm, int frames) override
+    {
+        while (frames > 0) {
+            snd_pcm_sframes_t n = snd_pcm_writei(pcm_, pcm, frames);
+            if (n < 0) {
+                // underrun (-EPIPE) or suspend: recover and write the period again
+                if (snd_pcm_recover(pcm_, (int)n, 1) < 0)
+                    return false;
+                continue;
+            }
+            pcm    += n * channels_;
+            frames -= (int)n;
+        }
+        return true;
+    }
+
+    long delay() override
+    {
+        snd_pcm_sframes_t d = 0;
+        return snd_pcm_delay(pcm_, &d) == 0 && d > 0 ? (long)d : 0;
+    }
+
+private:
+    snd_pcm_t* pcm_;
+    int        channels_;
+};
+#endif
+
+} // namespace
+
+//  WAV
+static uint32_t rd32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+static uint16_t rd16(const unsigned char* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+// PCM 8/16/24/32-bit, any rate and channel count, to S16
+bool AudioPlayer::load_wav()
 {
-    timeval tv;
-    gettimeofday(&tv, nullptr);
-    return (long long)tv.tv_sec * 1000LL + tv.tv_usec / 1000LL;
+    FILE* f = std::fopen(wav_path_.c_str(), "rb");
+    if (!f) {
+        std::perror(wav_path_.c_str());
+        return false;
+    }
+    std::vector<unsigned char> buf;
+    unsigned char chunk[65536];
+    size_t n;
+    while ((n = std::fread(chunk, 1, sizeof(chunk), f)) > 0)
+        buf.insert(buf.end(), chunk, chunk + n);
+    std::fclose(f);
+
+    if (buf.size() < 12 || std::memcmp(&buf[0], "RIFF", 4) != 0 || std::memcmp(&buf[8], "WAVE", 4) != 0) {
+        std::cerr << "[AUDIO] " << wav_path_ << ": not a WAV file\n";
+        return false;
+    }
+
+    int bits = 0;
+    const unsigned char* data = nullptr;
+    size_t data_len = 0;
+    for (size_t off = 12; off + 8 <= buf.size(); ) {
+        const unsigned char* c = &buf[off];
+        size_t len = rd32(c + 4);
+        if (off + 8 + len > buf.size())
+            len = buf.size() - off - 8;   // truncated file: take what is there
+        if (std::memcmp(c, "fmt ", 4) == 0 && len >= 16) {
+            const uint16_t fmt = rd16(c + 8);
+            if (fmt != 1 && fmt != 0xFFFE) {   // PCM or extensible PCM
+                std::cerr << "[AUDIO] " << wav_path_ << ": only PCM WAV is supported\n";
+                return false;
+            }
+            channels_ = rd16(c + 10);
+            rate_     = (int)rd32(c + 12);
+            bits      = rd16(c + 22);
+        } else if (std::memcmp(c, "data", 4) == 0) {
+            data = c + 8;
+            data_len = len;
+        }
+        off += 8 + len + (len & 1);
+    }
+    if (!data || channels_ <= 0 || rate_ <= 0 || (bits != 8 && bits != 16 && bits != 24 && bits != 32)) {
+        std::cerr << "[AUDIO] " << wav_path_ << ": unsupported WAV layout\n";
+        return false;
+    }
+
+    const int bps = bits / 8;
+    const size_t samples = data_len / bps;
+    pcm_.resize(samples - samples % channels_);
+    for (size_t i = 0; i < pcm_.size(); i++) {
+        const unsigned char* s = data + i * bps;
+        switch (bits) {
+        case 8:  pcm_[i] = (int16_t)((s[0] - 128) << 8); break;
+        case 16: pcm_[i] = (int16_t)rd16(s); break;
+        default: pcm_[i] = (int16_t)rd16(s + bps - 2); break;   // top 16 bits
+        }
+    }
+    return !pcm_.empty();
 }
 
-void AudioPlayer::play_blocking()
-{ 
-    std::string cmd = "aplay -q \"" + file + "\"";
-    std::system(cmd.c_str());
+//  AudioPlayer
+AudioPlayer::AudioPlayer(const std::string& wav_path, const AudioConfig& cfg)
+    : wav_path_(wav_path)
+    , cfg_(cfg)
+{
 }
 
-void AudioPlayer::play()
+AudioPlayer::~AudioPlayer()
 {
-    long long now = now_ms();
-    if (now - last_ms < throttle)
+    stop();
+}
+
+void AudioPlayer::set_listener(StartListener l)
+{
+    listener_ = std::move(l);
+}
+
+bool AudioPlayer::start()
+{
+    if (running_.load() || !load_wav())
+        return false;
+
+    if (cfg_.sink == AudioConfig::SINK_ALSA) {
+#ifdef HAVE_ALSA
+        snd_pcm_t* pcm = nullptr;
+        int err = snd_pcm_open(&pcm, cfg_.device.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+        if (err == 0)
+            err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                                     (unsigned)channels_, (unsigned)rate_, 1, (unsigned)cfg_.latency_us);
+        if (err == 0) {
+            sink_.reset(new AlsaSink(pcm, channels_));
+        } else {
+            std::cerr << "[AUDIO] ALSA " << cfg_.device << ": " << snd_strerror(err) << ", no sound\n";
+            if (pcm) snd_pcm_close(pcm);
+            cfg_.sink = AudioConfig::SINK_NULL;
+        }
+#else
+        std::cerr << "[AUDIO] built without ALSA, no sound\n";
+        cfg_.sink = AudioConfig::SINK_NULL;
+#endif
+    } else if (cfg_.sink == AudioConfig::SINK_FILE) {
+        FILE* f = std::fopen(cfg_.device.c_str(), "wb");
+        if (f) {
+            sink_.reset(new FileSink(f, rate_, channels_));
+        } else {
+            std::perror(cfg_.device.c_str());
+            cfg_.sink = AudioConfig::SINK_NULL;
+        }
+    }
+    if (cfg_.sink == AudioConfig::SINK_NULL)
+        sink_.reset(new NullSink(rate_));
+
+    running_ = true;
+    thread_ = std::thread(&AudioPlayer::run, this);
+    return true;
+}
+
+void AudioPlayer::stop()
+{
+    if (!running_.exchange(false))
         return;
+    if (thread_.joinable())
+        thread_.join();
+    sink_.reset();   // drains ALSA / finishes the WAV header
+}
 
-    last_ms = now;
+bool AudioPlayer::play(uint64_t frame_id, clock::time_point t_ref)
+{
+    const clock::time_point now = clock::now();
+    if (last_accept_ != clock::time_point() &&
+        now - last_accept_ < std::chrono::milliseconds(cfg_.throttle_ms))
+        return false;
 
-    std::thread t([this]()
-    {
-        play_blocking();
-    });
-    t.detach();
-}
\ No newline at end of file
+    const size_t t = q_tail_.load(std::memory_order_relaxed);
+    if (t - q_head_.load(std::memory_order_acquire) == kQueue)
+        return false;   // audio thread stalled
+    queue_[t & (kQueue - 1)].frame_id = frame_id;
+    queue_[t & (kQueue - 1)].t        = t_ref == clock::time_point() ? now : t_ref;
+    q_tail_.store(t + 1, std::memory_order_release);
+
+    last_accept_ = now;
+    return true;
+}
+
+std::string AudioPlayer::describe() const
+{
+    static const char* const kOverlap[] = { "ignore", "restart", "mix" };
+    std::string s;
+    switch (cfg_.sink) {
+    case AudioConfig::SINK_ALSA: s = "alsa:" + cfg_.device; break;
+    case AudioConfig::SINK_FILE: s = "file:" + cfg_.device; break;
+    case AudioConfig::SINK_NULL: s = "null"; break;
+    }
+    return s + " overlap=" + kOverlap[cfg_.overlap];
+}
+
+void AudioPlayer::take_triggers(std::vector<Voice>& voices)
+{
+    size_t h = q_head_.load(std::memory_order_relaxed);
+    const size_t t = q_tail_.load(std::memory_order_acquire);
+    for (; h != t; h++) {
+        Voice v;
+        v.pos     = 0;
+        v.started = false;
+        v.trig    = queue_[h & (kQueue - 1)];
+
+        if (!voices.empty()) {
+            if (cfg_.overlap == AudioConfig::OVERLAP_RESTART) {
+                voices.clear();
+            } else if (cfg_.overlap == AudioConfig::OVERLAP_IGNORE || voices.size() == kMaxVoices) {
+                ignored_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+        }
+        voices.push_back(v);
+    }
+    q_head_.store(h, std::memory_order_release);
+}
+
+void AudioPlayer::run()
+{
+    const int    period = std::max(16, cfg_.period_frames);
+    const size_t clip_frames = pcm_.size() / channels_;
+
+    std::vector<int16_t> out((size_t)period * channels_);
+    std::vector<int32_t> mix((size_t)period * channels_);
+    std::vector<Voice>   voices;
+    voices.reserve(kMaxVoices);
+
+    while (running_.load(std::memory_order_relaxed)) {
+        take_triggers(voices);
+
+        // mix this period; silence between alerts keeps the device running
+        std::fill(mix.begin(), mix.end(), 0);
+        for (Voice& v : voices) {
+            const size_t n = std::min((size_t)period, clip_frames - v.pos);
+            const int16_t* src = &pcm_[v.pos * channels_];
+            for (size_t i = 0; i < n * channels_; i++)
+                mix[i] += src[i];
+            v.pos += n;
+        }
+        for (size_t i = 0; i < out.size(); i++)
+            out[i] = (int16_t)std::max(-32768, std::min(32767, mix[i]));
+
+        // first sample of a new voice leaves after what is already queued
+        const long queued = sink_->delay();
+        const clock::time_point t_out = clock::now() + std::chrono::microseconds(1000000LL * queued / rate_);
+        if (!sink_->write(out.data(), period)) {
+            std::cerr << "[AUDIO] output failed, audio thread stops\n";
+            break;
+        }
+
+        for (Voice& v : voices) {
+            if (v.started)
+                continue;
+            v.started = true;
+            played_.fetch_add(1, std::memory_order_relaxed);
+            if (listener_)
+                listener_(v.trig.frame_id, v.trig.t, t_out);
+        }
+        voices.erase(std::remove_if(voices.begin(), voices.end(),
+                                    [clip_frames](const Voice& v) { return v.pos >= clip_frames; }),
+                     voices.end());
+    }
+}
@@ -1,23 +1,103 @@
 #ifndef AUDIO_PLAYER_HPP
 #define AUDIO_PLAYER_HPP
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
+struct AudioConfig
+{
+    enum Sink    { SINK_ALSA, SINK_FILE, SINK_NULL };
+    // a trigger while the alert is still sounding
+    enum Overlap { OVERLAP_IGNORE, OVERLAP_RESTART, OVERLAP_MIX };
+
+    Sink        sink          = SINK_ALSA;
+    std::string device        = "default";   // ALSA pcm name, or the .wav path of SINK_FILE
+    int         throttle_ms   = 2000;        // shortest gap between accepted triggers
+    Overlap     overlap       = OVERLAP_IGNORE;
+    int         period_frames = 256;         // samples per write, ~5 ms at 48 kHz
+    int         latency_us    = 20000;       // ALSA buffer
+};
+
+// alsa[:<pcm>] | file:<out.wav> | null
+bool parse_audio_sink(const std::string& spec, AudioConfig& cfg);
+
+// Alert sound engine. The WAV is decoded into memory once and one audio
+// thread keeps the output open, writing silence between alerts, so an
+// alert starts within a period plus the device buffer: no fork, no exec,
+// no file read. play() hands a trigger over a lock-free queue and never
+// blocks. The thread reports when each alert's first sample is due at the
+// output (write time + samples queued ahead of it), not when it was asked for.
 class AudioPlayer
 {
 public:
-    AudioPlayer(const std::string& file_path,
-                int throttle_ms = 2000);
+    using clock = std::chrono::steady_clock;
+    class Sink;   // output device, audio_player.cpp
+    // audio thread; frame id and reference time passed to play(), first sample out
+    using StartListener = std::function<void(uint64_t frame_id, clock::time_point t_trigger,
+                                             clock::time_point t_start)>;
+
+    AudioPlayer(const std::string& wav_path, const AudioConfig& cfg = AudioConfig());
+    ~AudioPlayer();
+
+    void set_listener(StartListener l);   // before start()
+    // loads the WAV and opens the sink (falls back to null if the device
+    // can't be opened); false if the WAV can't be used
+    bool start();
+    void stop();
 
-    void play();   // non-blocking, có chống spam
+    // one producer (the logic thread); false if throttled or the queue is full.
+    // t_ref is handed back to the listener, default: now
+    bool play(uint64_t frame_id = 0, clock::time_point t_ref = clock::time_point());
+
+    std::string describe() const;
+    uint64_t played() const  { return played_.load(std::memory_order_relaxed); }
+    uint64_t ignored() const { return ignored_.load(std::memory_order_relaxed); }   // overlap policy
 
 private:
-    std::string file;
-    int         throttle;
-    long long   last_ms;
+    struct Trigger {
+        uint64_t          frame_id;
+        clock::time_point t;
+    };
+    struct Voice {
+        size_t            pos;   // next frame of the clip
+        bool              started;
+        Trigger           trig;
+    };
+
+    static const size_t kQueue     = 16;   // power of two
+    static const size_t kMaxVoices = 4;
+
+    bool load_wav();
+    void run();
+    void take_triggers(std::vector<Voice>& voices);
+
+    std::string   wav_path_;
+    AudioConfig   cfg_;
+    StartListener listener_;
+
+    // clip, interleaved S16 at the WAV's rate and channel count
+    std::vector<int16_t> pcm_;
+    int                  rate_ = 0;
+    int                  channels_ = 0;
+
+    // SPSC trigger queue: play() -> audio thread
+    Trigger               queue_[kQueue];
+    std::atomic<size_t>   q_head_{0};   // audio thread
+    std::atomic<size_t>   q_tail_{0};   // producer
+    clock::time_point     last_accept_;   // producer only
+
+    std::unique_ptr<Sink> sink_;
+    std::atomic<bool>     running_{false};
+    std::thread           thread_;
 
-    void        play_blocking();
-    long long   now_ms() const;
+    std::atomic<uint64_t> played_{0};
+    std::atomic<uint64_t> ignored_{0};
 };
 
-#endif // AUDIO_PLAYER_HPP
\ No newline at end of file
+#endif // AUDIO_PLAYER_HPP
@@ -0,0 +1,74 @@
+// bench_alloc: steady-state heap allocations of yoloFastestv2.
+// Interposes the glibc allocator, warms the detector up, then counts heap
+// allocations per detection over further runs of the same frame, split by
+// stage. Preprocess and decode + NMS run on the detector's own buffers and
+// should report 0; ncnn's forward still allocates some bookkeeping per run
+// (blob vectors of multi-blob layers, pool allocator list nodes).
+//
+//   bench_alloc [param bin [image]]
+
+#include <cstdio>
+#include <vector>
+
+#define BENCH_COUNT_ALLOCS
+#include "bench_common.hpp"
+
+static const int kWarmup = 10;
+static const int kRuns   = 100;
+
+int main(int argc, char** argv)
+{
+    const char* param = (argc >= 3) ? argv[1] : "models/yolo-fastestv2-opt.param";
+    const char* bin   = (argc >= 3) ? argv[2] : "models/yolo-fastestv2-opt.bin";
+
+    yoloFastestv2 detector;
+    detector.init(false);
+    if (detector.loadModel(param, bin) != 0)
+        return -1;
+
+    cv::Mat frame;
+    if (argc >= 4)
+        frame = cv::imread(argv[3]);
+    if (frame.empty())
+        frame = synthFrame(640, 480);
+
+    // same path as the detector pool: preprocess into a reused input, person only
+    const std::vector<int> classes = { 0 };
+    ncnn::Mat              in;
+    ncnn::Mat              out[2];
+    std::vector<TargetBox> candidates;
+    std::vector<TargetBox> boxes;
+
+    // allocations per stage, summed over the measured runs
+    long stageAllocs[3] = { 0, 0, 0 };
+    for (int i = 0; i < kWarmup + kRuns; i++)
+    {
+        long a0 = allocCount();
+        detector.preprocess(frame, in);
+        long a1 = allocCount();
+        detector.forward(in, out);
+        long a2 = allocCount();
+        candidates.clear();
+        detector.predHandle(out, candidates, (float)frame.cols / in.w, (float)frame.rows / in.h,
+                            0.3f, classes);
+        detector.nmsHandle(candidates, boxes);
+        long a3 = allocCount();
+
+        if (i < kWarmup)
+            continue;
+        stageAllocs[0] += a1 - a0;
+        stageAllocs[1] += a2 - a1;
+        stageAllocs[2] += a3 - a2;
+    }
+
+    static const char* const kStage[3] = { "preprocess", "forward (ncnn)", "decode + NMS" };
+    long total = 0;
+    std::printf("%d warm-up + %d detections, heap allocations per detection:\n", kWarmup, kRuns);
+    for (int s = 0; s < 3; s++)
+    {
+        std::printf("  %-16s %8.2f\n", kStage[s], (double)stageAllocs[s] / kRuns);
+        total += stageAllocs[s];
+    }
+    std::printf("  %-16s %8.2f\n", "total", (double)total / kRuns);
+    return 0;
+}
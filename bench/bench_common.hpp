@@ -0,0 +1,107 @@
+// Fixtures shared by the benches (one translation unit per bench binary).
+//
+//   synthHead / synthFrame   synthetic detector heads and BGR frames
+//   allocCount               heap allocations so far, with BENCH_COUNT_ALLOCS
+//                            defined before the include: the glibc malloc
+//                            family is interposed and every call counted
+
+#ifndef BENCH_COMMON_HPP
+#define BENCH_COMMON_HPP
+
+#include <cmath>
+#include <random>
+
+#include "yolo-fastestv2.h"
+
+//  model shape
+static const int   kNumAnchor   = 3;
+static const int   kNumCategory = 80;
+static const int   kInputSize   = 352;
+static const float kThresh      = 0.30f;
+
+//  inputs
+// One head of shape (c=grid, h=grid, w=4A+A+C). A fraction `density`
+// of anchors get objectness above kThresh, class scores are a softmax
+// so they stay in (0,1] like the real model output.
+static inline ncnn::Mat synthHead(int grid, float density, std::mt19937& rng)
+{
+    const int outC = 4 * kNumAnchor + kNumAnchor + kNumCategory;
+    std::uniform_real_distribution<float> u01(0.f, 1.f);
+
+    ncnn::Mat feat(outC, grid, grid);
+    for (int h = 0; h < grid; h++)
+    {
+        float* values = feat.channel(h);
+        for (int w = 0; w < grid; w++, values += outC)
+        {
+            for (int k = 0; k < 4 * kNumAnchor; k++)
+                values[k] = u01(rng);
+            for (int b = 0; b < kNumAnchor; b++)
+                values[4 * kNumAnchor + b] = (u01(rng) < density)
+                    ? kThresh + (1.f - kThresh) * u01(rng)
+                    : kThresh * u01(rng);
+
+            float* cls = values + 5 * kNumAnchor;
+            float  sum = 0.f;
+            for (int k = 0; k < kNumCategory; k++)
+            {
+                cls[k] = std::exp(4.f * u01(rng));
+                sum += cls[k];
+            }
+            for (int k = 0; k < kNumCategory; k++)
+                cls[k] /= sum;
+            cls[(int)(u01(rng) * kNumCategory) % kNumCategory] += 0.5f;
+        }
+    }
+    return feat;
+}
+
+// deterministic diagonal pattern, every channel varies
+static inline cv::Mat synthFrame(int w, int h)
+{
+    cv::Mat m(h, w, CV_8UC3);
+    for (int y = 0; y < h; y++)
+    {
+        unsigned char* p = m.ptr<unsigned char>(y);
+        for (int x = 0; x < w * 3; x++)
+            p[x] = (unsigned char)((x * 7 + y * 13) & 0xff);
+    }
+    return m;
+}
+
+//  allocation counting
+#ifdef BENCH_COUNT_ALLOCS
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void* __libc_memalign(size_t, size_t);
+extern "C" void  __libc_free(void*);
+
+static std::atomic<long> g_allocs{0};
+
+static inline void countAlloc() { g_allocs.fetch_add(1, std::memory_order_relaxed); }
+static inline long allocCount() { return g_allocs.load(std::memory_order_relaxed); }
+
+extern "C" void* malloc(size_t n)             { countAlloc(); return __libc_malloc(n); }
+extern "C" void* calloc(size_t n, size_t s)   { countAlloc(); return __libc_calloc(n, s); }
+extern "C" void* realloc(void* p, size_t n)   { countAlloc(); return __libc_realloc(p, n); }
+extern "C" void* memalign(size_t a, size_t n) { countAlloc(); return __libc_memalign(a, n); }
+extern "C" void* aligned_alloc(size_t a, size_t n) { countAlloc(); return __libc_memalign(a, n); }
+extern "C" void  free(void* p)                { __libc_free(p); }
+extern "C" int   posix_memalign(void** out, size_t a, size_t n)
+{
+    countAlloc();
+    void* p = __libc_memalign(a, n);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+#endif // BENCH_COUNT_ALLOCS
+
+#endif // BENCH_COMMON_HPP
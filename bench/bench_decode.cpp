@@ -0,0 +1,212 @@
+// bench_decode: objectness-gated SIMD decode (yoloFastestv2::predHandle)
+// against the original scalar getCategory/predHandle, on feature maps
+// captured from the model or synthesized with a given objectness density.
+//
+//   bench_decode [density]                        synthetic maps
+//   bench_decode <param> <bin> <img> [img ...]    captured maps
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "bench_common.hpp"
+
+static const int   kIters       = 2000;
+
+static const float kAnchors[12] = {
+    12.64f, 19.39f,   37.88f, 51.48f,   55.71f, 138.31f,
+    126.91f, 78.23f,  131.57f, 214.55f, 279.92f, 258.87f
+};
+
+//  reference: decode as it was before the SIMD rewrite 
+static void refGetCategory(const float* values, int index,
+                           int& category, float& score)
+{
+    float objScore = values[4 * kNumAnchor + index];
+    float tmp      = 0.f;
+    category       = -1;
+    score          = 0.f;
+
+    int base = 4 * kNumAnchor + kNumAnchor;
+    for (int i = 0; i < kNumCategory; i++)
+    {
+        float clsScore = values[base + i] * objScore;
+        if (clsScore > tmp)
+        {
+            tmp      = clsScore;
+            score    = clsScore;
+            category = i;
+        }
+    }
+}
+
+static void refPredHandle(const ncnn::Mat* out, std::vector<TargetBox>& dstBoxes,
+                          float scaleW, float scaleH, float thresh)
+{
+    dstBoxes.clear();
+    for (int i = 0; i < 2; i++)
+    {
+        const ncnn::Mat& feat = out[i];
+        int outH = feat.c;
+        int outW = feat.h;
+        int outC = feat.w;
+        int stride = kInputSize / outH;
+
+        for (int h = 0; h < outH; h++)
+        {
+            const float* values = feat.channel(h);
+            for (int w = 0; w < outW; w++)
+            {
+                for (int b = 0; b < kNumAnchor; b++)
+                {
+                    int   cate = -1;
+                    float sc   = -1.f;
+                    refGetCategory(values, b, cate, sc);
+                    if (cate < 0 || sc <= thresh)
+                        continue;
+
+                    float bcx = ((values[b * 4 + 0] * 2.f - 0.5f) + w) * stride;
+                    float bcy = ((values[b * 4 + 1] * 2.f - 0.5f) + h) * stride;
+                    float bw  = std::pow(values[b * 4 + 2] * 2.f, 2.f) *
+                                kAnchors[i * kNumAnchor * 2 + b * 2 + 0];
+                    float bh  = std::pow(values[b * 4 + 3] * 2.f, 2.f) *
+                                kAnchors[i * kNumAnchor * 2 + b * 2 + 1];
+
+                    TargetBox box;
+                    box.x1    = (int)((bcx - 0.5f * bw) * scaleW);
+                    box.y1    = (int)((bcy - 0.5f * bh) * scaleH);
+                    box.x2    = (int)((bcx + 0.5f * bw) * scaleW);
+                    box.y2    = (int)((bcy + 0.5f * bh) * scaleH);
+                    box.score = sc;
+                    box.cate  = cate;
+                    dstBoxes.push_back(box);
+                }
+                values += outC;
+            }
+        }
+    }
+}
+
+//  inputs 
+struct Sample {
+    ncnn::Mat out[2];
+    float     scaleW = 1.f;
+    float     scaleH = 1.f;
+};
+
+static bool sameBoxes(const std::vector<TargetBox>& a, const std::vector<TargetBox>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].x1 != b[i].x1 || a[i].y1 != b[i].y1 ||
+            a[i].x2 != b[i].x2 || a[i].y2 != b[i].y2 ||
+            a[i].cate != b[i].cate || a[i].score != b[i].score)
+            return false;
+    }
+    return true;
+}
+
+template <class F>
+static double nsPerOp(const std::vector<Sample>& samples, F&& fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int it = 0; it < kIters; it++)
+        fn(samples[it % samples.size()]);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / kIters;
+}
+
+int main(int argc, char** argv)
+{
+    yoloFastestv2 detector;
+    detector.init(false);
+
+    std::vector<Sample> samples;
+
+    if (argc >= 4)
+    {
+        if (detector.loadModel(argv[1], argv[2]) != 0)
+            return -1;
+        for (int i = 3; i < argc; i++)
+        {
+            cv::Mat img = cv::imread(argv[i]);
+            ncnn::Mat in;
+            if (detector.preprocess(img, in) != 0)
+            {
+                std::fprintf(stderr, "skip unreadable image: %s\n", argv[i]);
+                continue;
+            }
+            Sample s;
+            detector.forward(in, s.out);
+            s.scaleW = (float)img.cols / kInputSize;
+            s.scaleH = (float)img.rows / kInputSize;
+            samples.push_back(s);
+        }
+    }
+    else
+    {
+        float density = (argc >= 2) ? (float)std::atof(argv[1]) : 0.01f;
+        std::mt19937 rng(12345);
+        for (int i = 0; i < 16; i++)
+        {
+            Sample s;
+            s.out[0] = synthHead(22, density, rng);
+            s.out[1] = synthHead(11, density, rng);
+            s.scaleW = 640.f / kInputSize;
+            s.scaleH = 480.f / kInputSize;
+            samples.push_back(s);
+        }
+        std::printf("synthetic maps, objectness density %.3f\n", density);
+    }
+
+    if (samples.empty())
+    {
+        std::fprintf(stderr, "no input\n");
+        return -1;
+    }
+
+    // correctness first: both decoders must emit the same candidates
+    std::vector<TargetBox> refBoxes, newBoxes;
+    size_t totalBoxes = 0;
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+        const Sample& s = samples[i];
+        refPredHandle(s.out, refBoxes, s.scaleW, s.scaleH, kThresh);
+        detector.predHandle(s.out, newBoxes, s.scaleW, s.scaleH, kThresh);
+        if (!sameBoxes(refBoxes, newBoxes))
+        {
+            std::fprintf(stderr, "MISMATCH on sample %zu: ref=%zu new=%zu boxes\n",
+                         i, refBoxes.size(), newBoxes.size());
+            return 1;
+        }
+        totalBoxes += refBoxes.size();
+    }
+    std::printf("%zu samples, %.1f candidates/sample, outputs identical\n",
+                samples.size(), (double)totalBoxes / samples.size());
+
+    refBoxes.reserve(kNumAnchor * (22 * 22 + 11 * 11));
+    newBoxes.reserve(kNumAnchor * (22 * 22 + 11 * 11));
+
+    double tRef = nsPerOp(samples, [&](const Sample& s) {
+        refPredHandle(s.out, refBoxes, s.scaleW, s.scaleH, kThresh);
+    });
+    double tNew = nsPerOp(samples, [&](const Sample& s) {
+        detector.predHandle(s.out, newBoxes, s.scaleW, s.scaleH, kThresh);
+    });
+
+    const std::vector<int> person = { 0 };
+    double tPerson = nsPerOp(samples, [&](const Sample& s) {
+        detector.predHandle(s.out, newBoxes, s.scaleW, s.scaleH, kThresh, person);
+    });
+
+    std::printf("reference decode : %10.0f ns/op\n", tRef);
+    std::printf("gated SIMD decode: %10.0f ns/op   (x%.2f)\n", tNew, tRef / tNew);
+    std::printf("person-only      : %10.0f ns/op   (x%.2f)\n", tPerson, tRef / tPerson);
+    return 0;
+}
@@ -0,0 +1,285 @@
+// bench_micro: per-kernel microbenchmarks for the detector hot paths.
+// Each row reports ns/op, heap allocations/op and, where perf_event_open
+// is allowed (perf_event_paranoid <= 2, or CAP_PERFMON), cycles,
+// instructions, cache misses and L1D read misses per op.
+//
+//  preprocess         yoloFastestv2::preprocess (the detector pool's resize +
+//                     normalize) from several source sizes
+//  predHandle         decode at objectness densities 0 .. 1, all classes
+//                     and person-only; at density 1 every anchor reaches
+//                     getCategory (private, inlined into the decode loop),
+//                     so those rows are its cost
+//  nmsHandle          on the candidates the same decode produced
+//  intersection_area  pairwise over a candidate set
+//
+//   bench_micro [--filter substr] [--iters N]
+//   bench_micro --model <param> <bin> <img> [img ...]   maps captured from the model
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "nms.hpp"
+#include "yolo-fastestv2.h"
+
+#define BENCH_COUNT_ALLOCS
+#include "bench_common.hpp"
+
+//  hardware counters
+// One group, read together; any event the kernel/CPU refuses is skipped.
+class PerfCounters
+{
+public:
+    enum { CYCLES, INSTRUCTIONS, CACHE_MISSES, L1D_MISSES, NUM };
+
+    PerfCounters()
+    {
+        const uint64_t l1dRead = PERF_COUNT_HW_CACHE_L1D |
+                                 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        open(CYCLES,       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        open(INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        open(CACHE_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        open(L1D_MISSES,   PERF_TYPE_HW_CACHE, l1dRead);
+    }
+
+    ~PerfCounters()
+    {
+        for (int i = 0; i < NUM; i++)
+            if (fd_[i] >= 0) close(fd_[i]);
+    }
+
+    bool any() const { return leader_ >= 0; }
+    bool has(int i) const { return fd_[i] >= 0; }
+
+    void start()
+    {
+        if (leader_ < 0) return;
+        ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    void stop(uint64_t out[NUM])
+    {
+        for (int i = 0; i < NUM; i++)
+            out[i] = 0;
+        if (leader_ < 0) return;
+        ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        // PERF_FORMAT_GROUP: nr, then one value per opened event in open order
+        uint64_t buf[1 + NUM];
+        if (read(leader_, buf, sizeof(buf)) < (ssize_t)sizeof(uint64_t))
+            return;
+        for (int i = 0, k = 0; i < NUM && k < (int)buf[0]; i++)
+            if (fd_[i] >= 0) out[i] = buf[1 + k++];
+    }
+
+private:
+    void open(int idx, uint32_t type, uint64_t config)
+    {
+        perf_event_attr pe;
+        std::memset(&pe, 0, sizeof(pe));
+        pe.size           = sizeof(pe);
+        pe.type           = type;
+        pe.config         = config;
+        pe.disabled       = (leader_ < 0);
+        pe.exclude_kernel = 1;
+        pe.exclude_hv     = 1;
+        pe.read_format    = PERF_FORMAT_GROUP;
+        int fd = (int)syscall(__NR_perf_event_open, &pe, 0, -1, leader_, 0);
+        if (fd < 0) return;
+        fd_[idx] = fd;
+        if (leader_ < 0) leader_ = fd;
+    }
+
+    int fd_[NUM] = { -1, -1, -1, -1 };
+    int leader_  = -1;
+};
+
+//  runner
+static PerfCounters* g_perf = nullptr;
+static std::string   g_filter;
+static int           g_iters = 0;   // 0 = per-benchmark default
+
+template <class F>
+static void bench(const std::string& name, int iters, F&& fn)
+{
+    if (!g_filter.empty() && name.find(g_filter) == std::string::npos)
+        return;
+    if (g_iters > 0)
+        iters = g_iters;
+
+    for (int i = 0; i < std::max(1, iters / 10); i++)   // warm caches and scratch buffers
+        fn(i);
+
+    uint64_t ctr[PerfCounters::NUM];
+    long a0 = allocCount();
+    g_perf->start();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iters; i++)
+        fn(i);
+    auto t1 = std::chrono::steady_clock::now();
+    g_perf->stop(ctr);
+    long allocs = allocCount() - a0;
+
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / iters;
+    std::printf("%-34s %12.1f %9.2f", name.c_str(), ns, (double)allocs / iters);
+    for (int c = 0; c < PerfCounters::NUM; c++)
+    {
+        if (g_perf->has(c))
+            std::printf(" %12.1f", (double)ctr[c] / iters);
+        else
+            std::printf(" %12s", "-");
+    }
+    std::printf("\n");
+}
+
+//  inputs
+struct Sample {
+    ncnn::Mat out[2];
+    float     scaleW = 640.f / kInputSize;
+    float     scaleH = 480.f / kInputSize;
+};
+
+static void runDecodeSet(yoloFastestv2& det, const std::string& tag,
+                         const std::vector<Sample>& samples)
+{
+    const std::vector<int> all;
+    const std::vector<int> person = { 0 };
+    const size_t n = samples.size();
+
+    std::vector<TargetBox> cand, kept;
+    cand.reserve(kNumAnchor * (22 * 22 + 11 * 11));
+
+    size_t total = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        det.predHandle(samples[i].out, cand, samples[i].scaleW, samples[i].scaleH, kThresh, all);
+        total += cand.size();
+    }
+    std::printf("# %s: %.1f candidates/frame (all classes)\n", tag.c_str(), (double)total / n);
+
+    bench("predHandle " + tag + " all", 2000, [&](int i) {
+        const Sample& s = samples[i % n];
+        det.predHandle(s.out, cand, s.scaleW, s.scaleH, kThresh, all);
+    });
+    bench("predHandle " + tag + " person", 2000, [&](int i) {
+        const Sample& s = samples[i % n];
+        det.predHandle(s.out, cand, s.scaleW, s.scaleH, kThresh, person);
+    });
+
+    // candidates decoded once, NMS timed alone
+    std::vector<std::vector<TargetBox>> cands(n);
+    for (size_t i = 0; i < n; i++)
+        det.predHandle(samples[i].out, cands[i], samples[i].scaleW, samples[i].scaleH, kThresh, all);
+    kept.reserve(cand.capacity());
+    bench("nmsHandle " + tag, 2000, [&](int i) {
+        det.nmsHandle(cands[i % n], kept);
+    });
+
+    // all pairs of one candidate set, the inner loop of a naive NMS
+    const std::vector<TargetBox>& c = cands[0];
+    if (c.size() >= 2)
+    {
+        volatile float sink = 0.f;
+        const size_t pairs = c.size() * (c.size() - 1) / 2;
+        const int iters = (int)std::max<size_t>(1, 2000000 / pairs);
+        bench("intersection_area " + tag + " x" + std::to_string(pairs), iters, [&](int) {
+            float acc = 0.f;
+            for (size_t a = 0; a < c.size(); a++)
+                for (size_t b = a + 1; b < c.size(); b++)
+                    acc += intersection_area((float)c[a].x1, (float)c[a].y1, (float)c[a].x2, (float)c[a].y2,
+                                             (float)c[b].x1, (float)c[b].y1, (float)c[b].x2, (float)c[b].y2);
+            sink = sink + acc;
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> images;
+    const char* param = nullptr;
+    const char* bin   = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string key = argv[i];
+        if (key == "--filter" && i + 1 < argc)     g_filter = argv[++i];
+        else if (key == "--iters" && i + 1 < argc) g_iters  = std::max(1, std::atoi(argv[++i]));
+        else if (key == "--model" && i + 2 < argc) { param = argv[++i]; bin = argv[++i]; }
+        else images.push_back(key);
+    }
+
+    PerfCounters perf;
+    g_perf = &perf;
+    if (!perf.any())
+        std::printf("# perf_event_open unavailable (see /proc/sys/kernel/perf_event_paranoid), counters shown as -\n");
+
+    yoloFastestv2 det;
+    det.init(false);
+    if (param && det.loadModel(param, bin) != 0)
+        return -1;
+
+    std::printf("%-34s %12s %9s %12s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op",
+                "cycles/op", "instr/op", "cachemiss/op", "L1Dmiss/op");
+
+    // preprocess: the frame sizes the camera / sources deliver
+    const int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 720 } };
+    for (const auto& sz : sizes)
+    {
+        cv::Mat frame = synthFrame(sz[0], sz[1]);
+        ncnn::Mat in;
+        bench("preprocess " + std::to_string(sz[0]) + "x" + std::to_string(sz[1]), 500,
+              [&](int) { det.preprocess(frame, in); });
+    }
+
+    // decode / NMS / IoU on controlled candidate densities
+    const float densities[] = { 0.f, 0.001f, 0.01f, 0.1f, 1.f };
+    std::mt19937 rng(12345);
+    for (float d : densities)
+    {
+        std::vector<Sample> samples(8);
+        for (Sample& s : samples)
+        {
+            s.out[0] = synthHead(22, d, rng);
+            s.out[1] = synthHead(11, d, rng);
+        }
+        char tag[32];
+        std::snprintf(tag, sizeof(tag), "d=%g", d);
+        runDecodeSet(det, tag, samples);
+    }
+
+    // recorded maps from real frames
+    if (param && !images.empty())
+    {
+        std::vector<Sample> samples;
+        for (size_t i = 0; i < images.size(); i++)
+        {
+            cv::Mat img = cv::imread(images[i]);
+            ncnn::Mat in;
+            if (det.preprocess(img, in) != 0)
+            {
+                std::fprintf(stderr, "skip unreadable image: %s\n", images[i].c_str());
+                continue;
+            }
+            Sample s;
+            det.forward(in, s.out);
+            s.scaleW = (float)img.cols / kInputSize;
+            s.scaleH = (float)img.rows / kInputSize;
+            samples.push_back(s);
+        }
+        if (!samples.empty())
+            runDecodeSet(det, "captured", samples);
+    }
+    return 0;
+}
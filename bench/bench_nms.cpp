@@ -0,0 +1,175 @@
+// bench_nms: NmsEngine (class-partitioned, grid-bucketed) against the
+// original O(n*k) nmsHandle, sweeping the candidate count from 10 to 5000
+// on crowded synthetic scenes (clusters of jittered duplicates).
+//
+//   bench_nms [num_classes]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "nms.hpp"
+#include "yolo-fastestv2.h"
+
+static const float kIouThresh = 0.25f;
+
+//  reference: nmsHandle as it was before NmsEngine 
+static float refIntersectionArea(const TargetBox& a, const TargetBox& b)
+{
+    if (a.x1 > b.x2 || a.x2 < b.x1 || a.y1 > b.y2 || a.y2 < b.y1)
+        return 0.f;
+
+    float inter_width  = (float)(std::min(a.x2, b.x2) - std::max(a.x1, b.x1));
+    float inter_height = (float)(std::min(a.y2, b.y2) - std::max(a.y1, b.y1));
+
+    return inter_width * inter_height;
+}
+
+static void refNms(std::vector<TargetBox>& tmpBoxes, std::vector<TargetBox>& dstBoxes)
+{
+    dstBoxes.clear();
+    std::sort(tmpBoxes.begin(), tmpBoxes.end(),
+              [](const TargetBox& a, const TargetBox& b) { return a.score > b.score; });
+
+    std::vector<int> picked;
+    picked.reserve(tmpBoxes.size());
+
+    for (size_t i = 0; i < tmpBoxes.size(); i++)
+    {
+        int keep = 1;
+        for (size_t j = 0; j < picked.size(); j++)
+        {
+            float inter_area = refIntersectionArea(tmpBoxes[i], tmpBoxes[picked[j]]);
+            float union_area = tmpBoxes[i].area() + tmpBoxes[picked[j]].area() - inter_area;
+            if (union_area <= 0.f)
+                continue;
+            float IoU = inter_area / union_area;
+
+            if (IoU > kIouThresh && tmpBoxes[i].cate == tmpBoxes[picked[j]].cate)
+            {
+                keep = 0;
+                break;
+            }
+        }
+        if (keep)
+            picked.push_back((int)i);
+    }
+
+    for (size_t i = 0; i < picked.size(); i++)
+        dstBoxes.push_back(tmpBoxes[picked[i]]);
+}
+
+//  input 
+// n candidates around n/12 "people" on a 640x480 frame, like a detector
+// run with a low threshold on a crowded scene. Scores are distinct so the
+// reference's unstable sort cannot reorder ties.
+static std::vector<TargetBox> makeScene(int n, int numClasses, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> u01(0.f, 1.f);
+    std::normal_distribution<float>       jitter(0.f, 6.f);
+
+    int numObjects = std::max(1, n / 12);
+    std::vector<TargetBox> objects(numObjects);
+    for (int i = 0; i < numObjects; i++)
+    {
+        int w = 20 + (int)(u01(rng) * 100);
+        int h = 40 + (int)(u01(rng) * 200);
+        objects[i].x1   = (int)(u01(rng) * (640 - w));
+        objects[i].y1   = (int)(u01(rng) * (480 - h));
+        objects[i].x2   = objects[i].x1 + w;
+        objects[i].y2   = objects[i].y1 + h;
+        objects[i].cate = (int)(u01(rng) * numClasses) % numClasses;
+    }
+
+    std::vector<TargetBox> boxes(n);
+    for (int i = 0; i < n; i++)
+    {
+        const TargetBox& o = objects[(int)(u01(rng) * numObjects) % numObjects];
+        boxes[i].x1    = o.x1 + (int)jitter(rng);
+        boxes[i].y1    = o.y1 + (int)jitter(rng);
+        boxes[i].x2    = o.x2 + (int)jitter(rng);
+        boxes[i].y2    = o.y2 + (int)jitter(rng);
+        boxes[i].cate  = o.cate;
+        boxes[i].score = 0.3f + 0.7f * (float)(i + 1) / (float)(n + 1);
+    }
+    std::shuffle(boxes.begin(), boxes.end(), rng);
+    return boxes;
+}
+
+static bool sameBoxes(const std::vector<TargetBox>& a, const std::vector<TargetBox>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].x1 != b[i].x1 || a[i].y1 != b[i].y1 ||
+            a[i].x2 != b[i].x2 || a[i].y2 != b[i].y2 ||
+            a[i].cate != b[i].cate || a[i].score != b[i].score)
+            return false;
+    }
+    return true;
+}
+
+template <class F>
+static double usPerOp(int iters, F&& fn)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    for (int it = 0; it < iters; it++)
+        fn();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(t1 - t0).count() / iters;
+}
+
+int main(int argc, char** argv)
+{
+    int numClasses = (argc >= 2) ? std::max(1, std::atoi(argv[1])) : 1;
+    const int counts[] = { 10, 50, 100, 250, 500, 1000, 2000, 5000 };
+
+    std::mt19937 rng(2024);
+
+    NmsConfig hard;
+    hard.iou_thresh = kIouThresh;
+    NmsConfig topk = hard;
+    topk.top_k = 20;
+    NmsConfig soft = hard;
+    soft.method       = NmsConfig::SOFT_GAUSSIAN;
+    soft.score_thresh = 0.3f;
+
+    NmsEngine engHard(hard), engTopk(topk), engSoft(soft);
+
+    std::printf("classes=%d  iou=%.2f  (us/op)\n", numClasses, kIouThresh);
+    std::printf("%6s %6s %12s %12s %12s %12s\n",
+                "n", "kept", "reference", "grid", "grid top20", "soft-gauss");
+
+    for (int n : counts)
+    {
+        std::vector<TargetBox> scene = makeScene(n, numClasses, rng);
+        std::vector<TargetBox> work, refOut, engOut;
+
+        work = scene;
+        refNms(work, refOut);
+        engHard.run(scene, engOut);
+        if (!sameBoxes(refOut, engOut))
+        {
+            std::fprintf(stderr, "MISMATCH at n=%d: ref=%zu grid=%zu kept\n",
+                         n, refOut.size(), engOut.size());
+            return 1;
+        }
+
+        int iters = std::max(5, 200000 / n);
+        if (n >= 1000) iters = std::max(5, iters / 4);
+
+        double tRef = usPerOp(iters, [&] { work = scene; refNms(work, refOut); });
+        double tCopy = usPerOp(iters, [&] { work = scene; });
+        double tHard = usPerOp(iters, [&] { engHard.run(scene, engOut); });
+        double tTopk = usPerOp(iters, [&] { engTopk.run(scene, engOut); });
+        double tSoft = usPerOp(iters, [&] { engSoft.run(scene, engOut); });
+
+        std::printf("%6d %6zu %12.1f %12.1f %12.1f %12.1f\n",
+                    n, refOut.size(), tRef - tCopy, tHard, tTopk, tSoft);
+    }
+    return 0;
+}
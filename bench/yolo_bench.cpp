@@ -0,0 +1,429 @@
+// yolo_bench: offline end-to-end benchmark, no camera needed.
+// Captures a fixed input set from a frame source into memory, then
+//  1. runs preprocess / inference / decode / NMS one after another on a
+//     single detector for each ncnn thread count, timing every stage;
+//  2. pushes the same frames through a DetectorPool (the detect path of
+//     yolo_cam) as fast as it takes them, for throughput and latency.
+// Warm-up iterations are run and discarded before each measurement.
+//
+//   yolo_bench [--model param bin] [--source synth:1|file:x.mp4|dir:imgs]
+//              [--inputs 64] [--warmup 20] [--iters 500] [--threads 1,2,4]
+//              [--workers 1] [--pipeline-threads 4] [--pipeline-iters 300]
+//              [--label name] [--json out.json]
+// With --json - the JSON goes to stdout and the report to stderr.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#include "detector_pool.hpp"
+#include "frame_pool.hpp"
+#include "frame_source.hpp"
+#include "yolo-fastestv2.h"
+
+static const float kThresh    = 0.30f;
+static const int   kInputSize = 352;   // model input, as in detection()
+
+typedef std::chrono::steady_clock Clock;
+
+static FILE* g_report = stdout;   // human-readable report, stderr under --json -
+
+static double usBetween(Clock::time_point a, Clock::time_point b)
+{
+    return std::chrono::duration<double, std::micro>(b - a).count();
+}
+
+//  latency samples
+struct Latency
+{
+    std::vector<double> us;
+
+    double mean = 0, p50 = 0, p95 = 0, p99 = 0, max = 0;
+
+    void summarize()
+    {
+        if (us.empty())
+            return;
+        std::sort(us.begin(), us.end());
+        double sum = 0;
+        for (size_t i = 0; i < us.size(); i++)
+            sum += us[i];
+        mean = sum / us.size();
+        p50  = at(0.50);
+        p95  = at(0.95);
+        p99  = at(0.99);
+        max  = us.back();
+    }
+
+    // nearest-rank percentile, us sorted
+    double at(double q) const
+    {
+        size_t rank = (size_t)(q * us.size() + 0.999999);
+        return us[std::min(us.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+};
+
+static void printLatency(const char* name, const Latency& l)
+{
+    std::fprintf(g_report, "  %-10s mean %9.1f  p50 %9.1f  p95 %9.1f  p99 %9.1f  max %9.1f us\n",
+                name, l.mean, l.p50, l.p95, l.p99, l.max);
+}
+
+static void jsonLatency(FILE* f, const char* name, const Latency& l, bool last)
+{
+    std::fprintf(f, "        \"%s\": {\"mean_us\": %.1f, \"p50_us\": %.1f, \"p95_us\": %.1f, "
+                    "\"p99_us\": %.1f, \"max_us\": %.1f}%s\n",
+                 name, l.mean, l.p50, l.p95, l.p99, l.max, last ? "" : ",");
+}
+
+// quoted JSON string, control characters escaped
+static void jsonString(FILE* f, const char* s)
+{
+    std::fputc('"', f);
+    for (; *s; s++)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\')
+            std::fprintf(f, "\\%c", c);
+        else if (c == '\n')
+            std::fputs("\\n", f);
+        else if (c == '\t')
+            std::fputs("\\t", f);
+        else if (c < 0x20)
+            std::fprintf(f, "\\u%04x", c);
+        else
+            std::fputc(c, f);
+    }
+    std::fputc('"', f);
+}
+
+static long peakRssKb()
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;   // KiB on Linux
+}
+
+//  stage run: one detector, stages timed separately
+struct StageRun
+{
+    int     threads = 0;
+    int     iters   = 0;
+    double  fps     = 0;   // sequential, 1 / mean total
+    double  boxes   = 0;   // mean kept boxes per frame
+    Latency pre, infer, decode, nms, total;
+};
+
+static int runStages(yoloFastestv2& det, const std::vector<cv::Mat>& inputs,
+                     int warmup, int iters, StageRun& run)
+{
+    const std::vector<int> classes = { 0 };
+    ncnn::Mat              in;
+    ncnn::Mat              out[2];
+    std::vector<TargetBox> cand, boxes;
+
+    run.iters = iters;
+    Latency* stages[] = { &run.pre, &run.infer, &run.decode, &run.nms, &run.total };
+    for (Latency* l : stages)
+        l->us.reserve(iters);
+
+    long kept = 0;
+    for (int it = -warmup; it < iters; it++)
+    {
+        const cv::Mat& frame = inputs[(it + warmup) % inputs.size()];
+        const float scaleW = (float)frame.cols / kInputSize;
+        const float scaleH = (float)frame.rows / kInputSize;
+
+        Clock::time_point t0 = Clock::now();
+        if (det.preprocess(frame, in) != 0)
+            return -1;
+        Clock::time_point t1 = Clock::now();
+        if (det.forward(in, out) != 0)
+            return -1;
+        Clock::time_point t2 = Clock::now();
+        det.predHandle(out, cand, scaleW, scaleH, kThresh, classes);
+        Clock::time_point t3 = Clock::now();
+        det.nmsHandle(cand, boxes);
+        Clock::time_point t4 = Clock::now();
+
+        if (it < 0)
+            continue;
+        run.pre.us.push_back(usBetween(t0, t1));
+        run.infer.us.push_back(usBetween(t1, t2));
+        run.decode.us.push_back(usBetween(t2, t3));
+        run.nms.us.push_back(usBetween(t3, t4));
+        run.total.us.push_back(usBetween(t0, t4));
+        kept += (long)boxes.size();
+    }
+
+    for (Latency* l : stages)
+        l->summarize();
+    run.fps   = run.total.mean > 0 ? 1e6 / run.total.mean : 0;
+    run.boxes = iters > 0 ? (double)kept / iters : 0;
+    return 0;
+}
+
+//  pipeline run: DetectorPool, frames submitted back to back
+struct PipelineRun
+{
+    int     workers = 0;
+    int     threads = 0;
+    int     frames  = 0;
+    double  fps     = 0;
+    Latency pre;       // submit -> preprocess done
+    Latency infer;     // inference + decode + NMS
+    Latency e2e;       // submit -> result
+};
+
+static int runPipeline(const char* param, const char* bin, const std::vector<cv::Mat>& inputs,
+                       int workers, int threads, int warmup, int frames, PipelineRun& run)
+{
+    DetectorPool pool(workers, threads);
+    if (pool.load(param, bin) != 0)
+        return -1;
+    pool.set_detection(kThresh, std::vector<int>(1, 0));
+    if (pool.start() != 0)
+        return -1;
+
+    const cv::Mat& first = inputs[0];
+    FramePool frames_pool(pool.max_in_flight() + 2, first.cols, first.rows);
+
+    run.workers = workers;
+    run.threads = threads;
+    run.frames  = frames;
+    run.pre.us.reserve(frames);
+    run.infer.us.reserve(frames);
+    run.e2e.us.reserve(frames);
+
+    const int total = warmup + frames;
+    Clock::time_point t_start = Clock::now();   // reset once the warm-up frames are out
+
+    std::thread consumer([&] {
+        DetResult res;
+        for (int i = 0; i < total; i++)
+        {
+            if (!pool.next(res))
+                return;
+            res.frame.reset();
+            if (i == warmup - 1)
+                t_start = Clock::now();
+            if (i < warmup)
+                continue;
+            run.pre.us.push_back(usBetween(res.t_submit, res.t_pp));
+            run.infer.us.push_back(usBetween(res.t_det_s, res.t_det_e));
+            run.e2e.us.push_back(usBetween(res.t_submit, res.t_det_e));
+        }
+    });
+
+    for (int i = 0; i < total; i++)
+    {
+        FrameRef slot;
+        while (!(slot = frames_pool.acquire()))
+            std::this_thread::yield();   // every slot still in the pipeline
+        inputs[i % inputs.size()].copyTo(slot.mat());
+        if (!pool.submit((uint64_t)i + 1, slot))
+            break;
+    }
+    consumer.join();
+    Clock::time_point t_end = Clock::now();
+    pool.stop();
+
+    run.fps = frames / std::max(1e-9, std::chrono::duration<double>(t_end - t_start).count());
+    run.pre.summarize();
+    run.infer.summarize();
+    run.e2e.summarize();
+    return 0;
+}
+
+static std::vector<int> parseList(const char* s)
+{
+    std::vector<int> v;
+    for (const char* p = s; *p; )
+    {
+        v.push_back(std::max(1, std::atoi(p)));
+        p = std::strchr(p, ',');
+        if (!p)
+            break;
+        p++;
+    }
+    return v;
+}
+
+int main(int argc, char** argv)
+{
+    const char*      param     = "models/yolo-fastestv2-opt.param";
+    const char*      bin       = "models/yolo-fastestv2-opt.bin";
+    std::string      source    = "synth:1";
+    int              numInputs = 64;
+    int              warmup    = 20;
+    int              iters     = 500;
+    std::vector<int> threads   = { 1, 2, 4 };
+    int              workers   = 1;
+    int              pipeThreads = 4;
+    int              pipeIters   = 300;
+    std::string      label;
+    std::string      jsonPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string key = argv[i];
+        bool more = i + 1 < argc;
+        if (key == "--model" && i + 2 < argc) { param = argv[++i]; bin = argv[++i]; }
+        else if (key == "--source" && more)   source      = argv[++i];
+        else if (key == "--inputs" && more)   numInputs   = std::max(1, std::atoi(argv[++i]));
+        else if (key == "--warmup" && more)   warmup      = std::max(0, std::atoi(argv[++i]));
+        else if (key == "--iters" && more)    iters       = std::max(1, std::atoi(argv[++i]));
+        else if (key == "--threads" && more)  threads     = parseList(argv[++i]);
+        else if (key == "--workers" && more)  workers     = std::max(0, std::atoi(argv[++i]));
+        else if (key == "--pipeline-threads" && more) pipeThreads = std::max(1, std::atoi(argv[++i]));
+        else if (key == "--pipeline-iters" && more)   pipeIters   = std::max(1, std::atoi(argv[++i]));
+        else if (key == "--label" && more)    label       = argv[++i];
+        else if (key == "--json" && more)     jsonPath    = argv[++i];
+        else
+        {
+            std::fprintf(stderr, "unknown or incomplete option %s\n", key.c_str());
+            return 2;
+        }
+    }
+
+    if (jsonPath == "-")
+        g_report = stderr;
+
+    // fixed input set, decoded up front so file/image I/O stays out of the timings
+    SourceConfig srcCfg;
+    if (!parse_source(source, srcCfg))
+    {
+        std::fprintf(stderr, "bad --source %s\n", source.c_str());
+        return 2;
+    }
+    srcCfg.fps = 0.0;
+    std::unique_ptr<FrameSource> src = open_frame_source(srcCfg);
+    if (!src)
+        return 1;
+    std::vector<cv::Mat> inputs;
+    for (int i = 0; i < numInputs; i++)
+    {
+        cv::Mat m(srcCfg.height, srcCfg.width, CV_8UC3);
+        if (!src->read(m))
+            break;
+        inputs.push_back(m);
+    }
+    if (inputs.empty())
+    {
+        std::fprintf(stderr, "source gave no frames\n");
+        return 1;
+    }
+    std::fprintf(g_report, "inputs: %zu frames %dx%d from %s\n", inputs.size(), srcCfg.width,
+                srcCfg.height, src->describe().c_str());
+
+    std::vector<StageRun> stageRuns;
+    for (size_t t = 0; t < threads.size(); t++)
+    {
+        yoloFastestv2 det;
+        det.init(false);
+        if (det.loadModel(param, bin) != 0)
+        {
+            std::fprintf(stderr, "failed to load %s / %s\n", param, bin);
+            return 1;
+        }
+        det.setNumThreads(threads[t]);
+
+        StageRun run;
+        run.threads = threads[t];
+        if (runStages(det, inputs, warmup, iters, run) != 0)
+        {
+            std::fprintf(stderr, "detection failed\n");
+            return 1;
+        }
+        std::fprintf(g_report, "stages, %d thread(s), %d iters: %.1f fps sequential, %.2f boxes/frame\n",
+                    run.threads, run.iters, run.fps, run.boxes);
+        printLatency("preprocess", run.pre);
+        printLatency("inference",  run.infer);
+        printLatency("decode",     run.decode);
+        printLatency("nms",        run.nms);
+        printLatency("total",      run.total);
+        stageRuns.push_back(run);
+    }
+
+    PipelineRun pipe;
+    if (workers > 0)
+    {
+        if (runPipeline(param, bin, inputs, workers, pipeThreads, warmup, pipeIters, pipe) != 0)
+        {
+            std::fprintf(stderr, "pipeline run failed\n");
+            return 1;
+        }
+        std::fprintf(g_report, "pipeline, %dx%d thread(s), %d frames: %.1f fps\n",
+                    pipe.workers, pipe.threads, pipe.frames, pipe.fps);
+        printLatency("preprocess", pipe.pre);
+        printLatency("infer+post", pipe.infer);
+        printLatency("end2end",    pipe.e2e);
+    }
+
+    const long rssKb = peakRssKb();
+    std::fprintf(g_report, "peak RSS %.1f MiB\n", rssKb / 1024.0);
+
+    if (jsonPath.empty())
+        return 0;
+
+    FILE* f = (jsonPath == "-") ? stdout : std::fopen(jsonPath.c_str(), "w");
+    if (!f)
+    {
+        std::perror(jsonPath.c_str());
+        return 1;
+    }
+    struct utsname un;
+    uname(&un);
+    std::fprintf(f, "{\n");
+    std::fprintf(f, "  \"label\": ");
+    jsonString(f, label.c_str());
+    std::fprintf(f, ",\n  \"machine\": ");
+    jsonString(f, un.machine);
+    std::fprintf(f, ",\n  \"cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    std::fprintf(f, "  \"source\": ");
+    jsonString(f, source.c_str());
+    std::fprintf(f, ",\n");
+    std::fprintf(f, "  \"inputs\": %zu,\n", inputs.size());
+    std::fprintf(f, "  \"width\": %d,\n  \"height\": %d,\n", srcCfg.width, srcCfg.height);
+    std::fprintf(f, "  \"warmup\": %d,\n", warmup);
+    std::fprintf(f, "  \"peak_rss_kb\": %ld,\n", rssKb);
+    std::fprintf(f, "  \"stages\": [\n");
+    for (size_t i = 0; i < stageRuns.size(); i++)
+    {
+        const StageRun& r = stageRuns[i];
+        std::fprintf(f, "    {\n      \"threads\": %d,\n      \"iters\": %d,\n"
+                        "      \"fps\": %.2f,\n      \"boxes_per_frame\": %.3f,\n"
+                        "      \"latency\": {\n",
+                     r.threads, r.iters, r.fps, r.boxes);
+        jsonLatency(f, "preprocess", r.pre,    false);
+        jsonLatency(f, "inference",  r.infer,  false);
+        jsonLatency(f, "decode",     r.decode, false);
+        jsonLatency(f, "nms",        r.nms,    false);
+        jsonLatency(f, "total",      r.total,  true);
+        std::fprintf(f, "      }\n    }%s\n", i + 1 < stageRuns.size() ? "," : "");
+    }
+    std::fprintf(f, "  ]");
+    if (workers > 0)
+    {
+        std::fprintf(f, ",\n  \"pipeline\": {\n    \"workers\": %d,\n    \"threads\": %d,\n"
+                        "    \"frames\": %d,\n    \"fps\": %.2f,\n    \"latency\": {\n",
+                     pipe.workers, pipe.threads, pipe.frames, pipe.fps);
+        jsonLatency(f, "preprocess", pipe.pre,   false);
+        jsonLatency(f, "infer_post", pipe.infer, false);
+        jsonLatency(f, "end2end",    pipe.e2e,   true);
+        std::fprintf(f, "    }\n  }");
+    }
+    std::fprintf(f, "\n}\n");
+    if (f != stdout)
+        std::fclose(f);
+    return 0;
+}
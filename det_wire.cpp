@@ -0,0 +1,267 @@
+#include "det_wire.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//  little-endian helpers
+static void put_u16(char* p, uint16_t v)
+{
+    p[0] = (char)(v & 0xff);
+    p[1] = (char)(v >> 8);
+}
+
+static void put_u32(char* p, uint32_t v)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = (char)((v >> (8 * i)) & 0xff);
+}
+
+static void put_u64(char* p, uint64_t v)
+{
+    for (int i = 0; i < 8; i++)
+        p[i] = (char)((v >> (8 * i)) & 0xff);
+}
+
+static void put_f32(char* p, float f)
+{
+    uint32_t v;
+    std::memcpy(&v, &f, 4);
+    put_u32(p, v);
+}
+
+static uint16_t get_u16(const uint8_t* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const uint8_t* p)
+{
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static float get_f32(const uint8_t* p)
+{
+    uint32_t v = get_u32(p);
+    float f;
+    std::memcpy(&f, &v, 4);
+    return f;
+}
+
+//  decoder
+const char* det_decode_status_name(DetDecodeStatus s)
+{
+    switch (s) {
+    case DET_OK:          return "ok";
+    case DET_SHORT:       return "short";
+    case DET_BAD_MAGIC:   return "bad magic";
+    case DET_BAD_VERSION: return "bad version";
+    }
+    return "?";
+}
+
+DetDecodeStatus det_wire_decode(const void* data, size_t len, DetWirePacket& out)
+{
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    if (len < 3)
+        return DET_SHORT;
+    if (p[0] != 'Y' || p[1] != 'D')
+        return DET_BAD_MAGIC;
+    if (p[2] != kDetWireVersion)
+        return DET_BAD_VERSION;
+    if (len < kDetHeaderSize)
+        return DET_SHORT;
+
+    const size_t hsize = get_u16(p + 4);
+    const size_t count = get_u16(p + 6);
+    if (hsize < kDetHeaderSize || len < hsize + count * kDetBoxSize)
+        return DET_SHORT;
+
+    out.version  = p[2];
+    out.person   = (p[3] & kDetFlagPerson) != 0;
+    out.frame_id = get_u64(p + 8);
+    out.ts_ms    = get_u64(p + 16);
+    out.loop_fps = get_f32(p + 24);
+    out.det_fps  = get_f32(p + 28);
+
+    out.boxes.resize(count);
+    const uint8_t* b = p + hsize;
+    for (size_t i = 0; i < count; i++, b += kDetBoxSize) {
+        DetWireBox& box = out.boxes[i];
+        box.x1    = get_f32(b);
+        box.y1    = get_f32(b + 4);
+        box.x2    = get_f32(b + 8);
+        box.y2    = get_f32(b + 12);
+        box.score = get_f32(b + 16);
+        box.cls   = get_u16(b + 20);
+    }
+    return DET_OK;
+}
+
+//  writer
+// Longest JSON header: the keys, a 20-digit frame id and three numbers of
+// at most 31 chars each (put_fixed's limit).
+static const size_t kJsonHeaderMax = sizeof("{\"ts\":,\"frame_id\":,\"loop_fps\":,\"det_fps\":"
+                                            ",\"person\":false,\"detections\":[") - 1 + 20 + 3 * 31;
+
+static size_t min_capacity(DetWriter::Format fmt)
+{
+    return fmt == DetWriter::JSON ? kJsonHeaderMax + 2   // + "]}"
+                                  : kDetHeaderSize;
+}
+
+DetWriter::DetWriter(Format fmt, size_t capacity)
+    : fmt_(fmt)
+    , buf_(capacity < min_capacity(fmt) ? min_capacity(fmt) : capacity)
+{
+}
+
+bool DetWriter::put(const char* s, size_t n)
+{
+    if (len_ + n > limit_)
+        return false;
+    std::memcpy(&buf_[len_], s, n);
+    len_ += n;
+    return true;
+}
+
+// Same digits as printf("%.*f"): round the scaled value by hand, and leave
+// the few values whose scaled double sits next to a rounding tie (where the
+// double and the exact decimal could round apart), NaN/inf and huge values
+// to snprintf, into a stack buffer.
+bool DetWriter::put_fixed(double v, int decimals)
+{
+    static const double kScale[] = { 1.0, 10.0, 100.0, 1000.0 };
+    char tmp[32];
+
+    const double a  = std::fabs(v) * kScale[decimals];
+    const double fl = std::floor(a);
+    const double tol = a * 4e-16 > 1e-6 ? a * 4e-16 : 1e-6;
+    if (!(a < 9e15) || std::fabs(a - fl - 0.5) < tol) {
+        int n = std::snprintf(tmp, sizeof(tmp), "%.*f", decimals, v);
+        return n > 0 && n < (int)sizeof(tmp) && put(tmp, (size_t)n);
+    }
+
+    uint64_t r = (uint64_t)fl + (a - fl > 0.5 ? 1 : 0);
+    char* end = tmp + sizeof(tmp);
+    char* p   = end;
+    for (int i = 0; i < decimals; i++) {
+        *--p = (char)('0' + r % 10);
+        r /= 10;
+    }
+    *--p = '.';
+    do {
+        *--p = (char)('0' + r % 10);
+        r /= 10;
+    } while (r);
+    if (std::signbit(v))
+        *--p = '-';
+    return put(p, (size_t)(end - p));
+}
+
+static size_t format_u64(char* tmp, uint64_t v)   // tmp >= 20 chars, returns offset of first digit
+{
+    size_t i = 20;
+    do {
+        tmp[--i] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    return i;
+}
+
+#define DET_PUT_LIT(s) put(s, sizeof(s) - 1)
+
+void DetWriter::begin(uint64_t frame_id, double ts, double loop_fps, double det_fps, bool person)
+{
+    len_     = 0;
+    count_   = 0;
+    dropped_ = 0;
+
+    if (fmt_ == BINARY) {
+        limit_ = buf_.size();
+        char* h = &buf_[0];
+        std::memset(h, 0, kDetHeaderSize);
+        h[0] = 'Y';
+        h[1] = 'D';
+        h[2] = (char)kDetWireVersion;
+        h[3] = (char)(person ? kDetFlagPerson : 0);
+        put_u16(h + 4, (uint16_t)kDetHeaderSize);
+        put_u64(h + 8, frame_id);
+        put_u64(h + 16, ts > 0.0 ? (uint64_t)std::llround(ts * 1000.0) : 0);
+        put_f32(h + 24, (float)loop_fps);
+        put_f32(h + 28, (float)det_fps);
+        len_ = kDetHeaderSize;
+        return;
+    }
+
+    // the header always fits: capacity >= kJsonHeaderMax + 2. A number too
+    // long for put_fixed goes out as null so the message stays valid JSON.
+    limit_ = buf_.size() - 2;
+    char num[20];
+    DET_PUT_LIT("{\"ts\":");
+    if (!put_fixed(ts, 3)) DET_PUT_LIT("null");
+    DET_PUT_LIT(",\"frame_id\":");
+    size_t off = format_u64(num, frame_id);
+    put(num + off, sizeof(num) - off);
+    DET_PUT_LIT(",\"loop_fps\":");
+    if (!put_fixed(loop_fps, 2)) DET_PUT_LIT("null");
+    DET_PUT_LIT(",\"det_fps\":");
+    if (!put_fixed(det_fps, 2)) DET_PUT_LIT("null");
+    if (person) DET_PUT_LIT(",\"person\":true");
+    else        DET_PUT_LIT(",\"person\":false");
+    DET_PUT_LIT(",\"detections\":[");
+}
+
+void DetWriter::add_box(int cls, float score, float x1, float y1, float x2, float y2)
+{
+    if (fmt_ == BINARY) {
+        if (len_ + kDetBoxSize > limit_ || count_ == 0xffff) {
+            dropped_++;
+            return;
+        }
+        char* b = &buf_[len_];
+        put_f32(b, x1);
+        put_f32(b + 4, y1);
+        put_f32(b + 8, x2);
+        put_f32(b + 12, y2);
+        put_f32(b + 16, score);
+        put_u16(b + 20, (uint16_t)cls);
+        put_u16(b + 22, 0);
+        len_ += kDetBoxSize;
+        count_++;
+        return;
+    }
+
+    const size_t mark = len_;
+    bool ok = (count_ == 0 || DET_PUT_LIT(","))
+           && (cls == 0 ? DET_PUT_LIT("{\"cls\":\"person\"") : DET_PUT_LIT("{\"cls\":\"other\""))
+           && DET_PUT_LIT(",\"conf\":") && put_fixed(score, 3)
+           && DET_PUT_LIT(",\"bbox\":[") && put_fixed(x1, 3)
+           && DET_PUT_LIT(",") && put_fixed(y1, 3)
+           && DET_PUT_LIT(",") && put_fixed(x2, 3)
+           && DET_PUT_LIT(",") && put_fixed(y2, 3)
+           && DET_PUT_LIT("]}");
+    if (!ok) {
+        len_ = mark;   // whole boxes only
+        dropped_++;
+        return;
+    }
+    count_++;
+}
+
+void DetWriter::finish()
+{
+    if (fmt_ == BINARY) {
+        put_u16(&buf_[6], (uint16_t)count_);
+        return;
+    }
+    limit_ = buf_.size();
+    DET_PUT_LIT("]}");
+}
+
+#undef DET_PUT_LIT
@@ -0,0 +1,104 @@
+#ifndef DET_WIRE_HPP
+#define DET_WIRE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Detection messages on the wire (UDP :9001 and anything downstream).
+//
+// DetWriter builds one message per frame into a buffer allocated once, in
+// either format:
+//
+//   JSON    {"ts":..,"frame_id":..,"loop_fps":..,"det_fps":..,"person":..,
+//            "detections":[{"cls":"person","conf":..,"bbox":[x1,y1,x2,y2]},..]}
+//           byte-for-byte what the ostringstream version wrote (ts, conf,
+//           bbox with 3 decimals, fps with 2)
+//
+//   binary  little-endian, versioned:
+//             header  32 bytes
+//               0  char[2] magic "YD"
+//               2  u8      version (kDetWireVersion)
+//               3  u8      flags (kDetFlagPerson)
+//               4  u16     header size, boxes start here
+//               6  u16     box count
+//               8  u64     frame id
+//              16  u64     timestamp, unix epoch ms
+//              24  f32     loop fps
+//              28  f32     det fps
+//             box     24 bytes each: f32 x1, y1, x2, y2, score; u16 class id; u16 0
+//
+// A decoder accepts any header size >= 32 with the same version, so fields
+// can be appended to the header without a version bump; a changed box
+// layout bumps the version. det_wire has no dependencies beyond the C++
+// standard library, consumers link the det_wire library alone.
+static const uint8_t  kDetWireVersion = 1;
+static const uint8_t  kDetFlagPerson  = 1u << 0;
+static const size_t   kDetHeaderSize  = 32;
+static const size_t   kDetBoxSize     = 24;
+static const size_t   kDetMaxDatagram = 65507;   // largest IPv4 UDP payload
+
+struct DetWireBox
+{
+    float    x1, y1, x2, y2;
+    float    score;
+    uint16_t cls;
+};
+
+struct DetWirePacket
+{
+    uint8_t  version  = 0;
+    bool     person   = false;
+    uint64_t frame_id = 0;
+    uint64_t ts_ms    = 0;
+    float    loop_fps = 0.f;
+    float    det_fps  = 0.f;
+    std::vector<DetWireBox> boxes;
+};
+
+enum DetDecodeStatus
+{
+    DET_OK = 0,
+    DET_SHORT,         // shorter than its header or box count says
+    DET_BAD_MAGIC,     // not a binary detection message (JSON starts with '{')
+    DET_BAD_VERSION,
+};
+
+const char* det_decode_status_name(DetDecodeStatus s);
+
+// Parse one binary message; out.boxes keeps its capacity across calls.
+DetDecodeStatus det_wire_decode(const void* data, size_t len, DetWirePacket& out);
+
+class DetWriter
+{
+public:
+    enum Format { JSON, BINARY };
+
+    // capacity is raised to at least the longest header (+ "]}" for JSON)
+    explicit DetWriter(Format fmt = JSON, size_t capacity = kDetMaxDatagram);
+
+    Format format() const { return fmt_; }
+
+    // begin .. add_box* .. finish; data()/size() valid until the next begin().
+    // Boxes that would not fit the buffer are left out, the message stays valid.
+    void begin(uint64_t frame_id, double ts, double loop_fps, double det_fps, bool person);
+    void add_box(int cls, float score, float x1, float y1, float x2, float y2);
+    void finish();
+
+    const char* data() const { return buf_.data(); }
+    size_t      size() const { return len_; }
+    size_t      dropped_boxes() const { return dropped_; }   // in the last message
+
+private:
+    bool put(const char* s, size_t n);
+    bool put_fixed(double v, int decimals);
+
+    Format            fmt_;
+    std::vector<char> buf_;
+    size_t            len_     = 0;
+    size_t            limit_   = 0;   // JSON keeps room for the closing "]}"
+    size_t            count_   = 0;
+    size_t            dropped_ = 0;
+};
+
+#endif // DET_WIRE_HPP
@@ -0,0 +1,171 @@
+#include "detector_pool.hpp"
+
+#include <algorithm>
+
+DetectorPool::DetectorPool(int num_workers, int threads_per_worker, int pipeline_depth)
+    : threads_per_worker_(std::max(threads_per_worker, 1))
+    , depth_(std::max(pipeline_depth, 1))
+    , thresh_(0.3f)
+{
+    num_workers = std::max(num_workers, 1);
+    for (int i = 0; i < num_workers; i++)
+    {
+        workers_.emplace_back(new yoloFastestv2());
+        workers_.back()->setNumThreads(threads_per_worker_);
+    }
+    window_.resize(depth_ * num_workers);
+}
+
+DetectorPool::~DetectorPool()
+{
+    stop();
+}
+
+int DetectorPool::load(const char* param_path, const char* bin_path, bool use_vulkan)
+{
+    yoloFastestv2& primary = *workers_[0];
+    primary.init(use_vulkan);
+    if (primary.loadModel(param_path, bin_path) != 0)
+        return -1;
+
+    for (size_t i = 1; i < workers_.size(); i++)
+    {
+        if (workers_[i]->shareModel(primary) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+void DetectorPool::set_detection(float thresh, const std::vector<int>& classes)
+{
+    thresh_  = thresh;
+    classes_ = classes;
+}
+
+int DetectorPool::start()
+{
+    if (running_.exchange(true))
+        return 0;
+    for (size_t i = 0; i < workers_.size(); i++)
+    {
+        if (workers_[i]->startAsync(depth_, thresh_, classes_) != 0)
+        {
+            stop();
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void DetectorPool::stop()
+{
+    if (!running_.exchange(false))
+        return;
+
+    for (size_t i = 0; i < workers_.size(); i++)
+        workers_[i]->stopAsync();
+
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (size_t i = 0; i < window_.size(); i++)
+            window_[i].frame.reset();
+    }
+    cv_done_.notify_all();
+    cv_space_.notify_all();
+}
+
+bool DetectorPool::submit(uint64_t frame_id, const FrameRef& frame, bool run_infer,
+                          uint32_t flags, const std::vector<cv::Rect>& tiles)
+{
+    auto t_submit = std::chrono::steady_clock::now();
+
+    uint64_t seq;
+    int      idx;
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        cv_space_.wait(lk, [this] {
+            return !running_.load() || seq_in_ - seq_out_ < window_.size();
+        });
+        if (!running_.load())
+            return false;
+
+        seq = seq_in_++;
+        Slot& slot = window_[seq % window_.size()];
+        slot.res.frame_id  = frame_id;
+        slot.res.ran_infer = run_infer;
+        slot.res.flags     = flags;
+        slot.res.t_submit  = t_submit;
+        slot.frame         = frame;
+
+        if (!run_infer)
+        {
+            slot.res.worker = -1;
+            slot.res.boxes.clear();
+            slot.res.t_pp_s = slot.res.t_pp = t_submit;
+            slot.res.t_det_s = slot.res.t_infer_e = slot.res.t_det_e = t_submit;
+            slot.ready = true;
+            lk.unlock();
+            cv_done_.notify_all();
+            return true;
+        }
+
+        idx = rr_;
+        rr_ = (rr_ + 1) % (int)workers_.size();
+    }
+
+    // captures fit std::function's small buffer: no allocation per frame
+    uint64_t h = workers_[idx]->submit(frame.mat(), tiles, [this, seq, idx](uint64_t, AsyncResult& r) {
+        on_result(seq, idx, r);
+    });
+    return h != 0;
+}
+
+void DetectorPool::on_result(uint64_t seq, int worker, AsyncResult& result)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        Slot& slot = window_[seq % window_.size()];
+
+        slot.res.worker  = worker;
+        slot.res.t_pp_s    = result.t_pp_s;
+        slot.res.t_pp      = result.t_pp;
+        slot.res.t_det_s   = result.t_infer_s;
+        slot.res.t_infer_e = result.t_infer_e;
+        slot.res.t_det_e = result.t_done;
+        slot.res.boxes.swap(result.boxes);
+        slot.ready = true;
+    }
+    cv_done_.notify_all();
+}
+
+bool DetectorPool::next(DetResult& out)
+{
+    std::unique_lock<std::mutex> lk(mtx_);
+    Slot* slot = nullptr;
+    cv_done_.wait(lk, [this, &slot] {
+        slot = &window_[seq_out_ % window_.size()];
+        return !running_.load() || slot->ready;
+    });
+    if (!running_.load())
+        return false;
+
+    // swap keeps both box vectors' capacity alive, no allocation
+    out.boxes.swap(slot->res.boxes);
+    out.frame_id  = slot->res.frame_id;
+    out.ran_infer = slot->res.ran_infer;
+    out.flags     = slot->res.flags;
+    out.worker    = slot->res.worker;
+    out.t_submit  = slot->res.t_submit;
+    out.t_pp_s    = slot->res.t_pp_s;
+    out.t_pp      = slot->res.t_pp;
+    out.t_det_s   = slot->res.t_det_s;
+    out.t_infer_e = slot->res.t_infer_e;
+    out.t_det_e   = slot->res.t_det_e;
+    out.frame     = std::move(slot->frame);
+
+    slot->ready = false;
+    seq_out_++;
+    lk.unlock();
+    cv_space_.notify_one();
+    return true;
+}
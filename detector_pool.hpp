@@ -0,0 +1,99 @@
+#ifndef DETECTOR_POOL_HPP
+#define DETECTOR_POOL_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "frame_pool.hpp"
+#include "yolo-fastestv2.h"
+
+struct DetResult
+{
+    uint64_t               frame_id  = 0;
+    bool                   ran_infer = false;
+    uint32_t               flags     = 0;    // caller bits from submit(), untouched
+    int                    worker    = -1;
+    std::vector<TargetBox> boxes;
+    FrameRef               frame;   // the frame itself, reset it once done with it
+
+    std::chrono::steady_clock::time_point t_submit;   // handed to the pool
+    std::chrono::steady_clock::time_point t_pp_s;     // preprocess started
+    std::chrono::steady_clock::time_point t_pp;       // preprocess done
+    std::chrono::steady_clock::time_point t_det_s;    // inference started
+    std::chrono::steady_clock::time_point t_infer_e;  // inference done, decode + NMS started
+    std::chrono::steady_clock::time_point t_det_e;    // inference + decode done
+};
+
+// N detectors sharing one loaded model, each with its own ncnn thread
+// budget (e.g. 2x2 or 4x1 on a Pi 4) and its own async stage pipeline.
+// Frames are dispatched round-robin and results come back out of next()
+// in submission order.
+//
+// Meant for one submitting thread and one consuming thread.
+class DetectorPool
+{
+public:
+    DetectorPool(int num_workers, int threads_per_worker, int pipeline_depth = 3);
+    ~DetectorPool();
+
+    DetectorPool(const DetectorPool&) = delete;
+    DetectorPool& operator=(const DetectorPool&) = delete;
+
+    int  load(const char* param_path, const char* bin_path,
+              bool use_vulkan = false);
+    void set_detection(float thresh, const std::vector<int>& classes);
+
+    int  start();
+    void stop();   // wakes blocked submit()/next() callers, drops pending frames
+
+    // Blocks while the next worker's pipeline or the reorder window is
+    // full. run_infer = false passes the frame through with no boxes but
+    // keeps its place in the output order. flags come back in DetResult.
+    // tiles: crops to run on (see yoloFastestv2::detection), empty = whole frame.
+    bool submit(uint64_t frame_id, const FrameRef& frame, bool run_infer = true,
+                uint32_t flags = 0,
+                const std::vector<cv::Rect>& tiles = std::vector<cv::Rect>());
+
+    // next result in submission order; false once stopped
+    bool next(DetResult& out);
+
+    int workers() const { return (int)workers_.size(); }
+    int threads_per_worker() const { return threads_per_worker_; }
+    // frames the pool may hold at once, plus the one last handed out by
+    // next() (size the FramePool with this)
+    int max_in_flight() const { return (int)window_.size(); }
+
+private:
+    struct Slot {
+        bool      ready = false;
+        FrameRef  frame;   // kept alive until next() hands it out
+        DetResult res;
+    };
+
+    void on_result(uint64_t seq, int worker, AsyncResult& result);
+
+    std::vector<std::unique_ptr<yoloFastestv2>> workers_;
+    int                                         threads_per_worker_;
+    int                                         depth_;
+
+    float            thresh_;
+    std::vector<int> classes_;
+
+    // reorder window, slot = seq % size
+    std::mutex              mtx_;
+    std::condition_variable cv_done_;
+    std::condition_variable cv_space_;
+    std::vector<Slot>       window_;
+    uint64_t                seq_in_  = 0;
+    uint64_t                seq_out_ = 0;
+    int                     rr_      = 0;
+
+    std::atomic<bool> running_{false};
+};
+
+#endif // DETECTOR_POOL_HPP
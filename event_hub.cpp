@@ -0,0 +1,80 @@
+#include "event_hub.hpp"
+
+#include <chrono>
+
+EventHub::EventHub(size_t backlog, int max_subscribers)
+    : backlog_(backlog ? backlog : 1)
+    , max_subscribers_(max_subscribers)
+{
+}
+
+void EventHub::publish(uint64_t frame_id, const char* json, size_t len)
+{
+    if (!has_subscribers())
+        return;
+
+    // framed once here, outside the lock; every subscriber writes these bytes
+    std::shared_ptr<SseEvent> e = std::make_shared<SseEvent>();
+    e->frame_id = frame_id;
+    e->text.reserve(len + 32);
+    e->text += "id: ";
+    e->text += std::to_string(frame_id);
+    e->text += "\ndata: ";
+    e->text.append(json, len);
+    e->text += "\n\n";
+
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        e->seq = ++seq_;
+        events_.push_back(std::move(e));
+        if (events_.size() > backlog_)
+            events_.pop_front();   // the last reference may be a subscriber's, freed there
+    }
+    published_.fetch_add(1, std::memory_order_relaxed);
+    cv_.notify_all();
+}
+
+bool EventHub::subscribe()
+{
+    int n = subscribers_.load(std::memory_order_relaxed);
+    do {
+        if (n >= max_subscribers_)
+            return false;
+    } while (!subscribers_.compare_exchange_weak(n, n + 1, std::memory_order_relaxed));
+    return true;
+}
+
+void EventHub::unsubscribe()
+{
+    subscribers_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+SseEventPtr EventHub::next(uint64_t after, int timeout_ms)
+{
+    std::unique_lock<std::mutex> lk(mtx_);
+    const bool ready = cv_.wait_for(lk, std::chrono::milliseconds(timeout_ms), [&] {
+        return !running_ || (!events_.empty() && events_.back()->frame_id > after);
+    });
+    if (!ready || !running_)
+        return nullptr;
+
+    for (const SseEventPtr& e : events_)
+        if (e->frame_id > after)
+            return e;
+    return nullptr;   // not reached: back() is newer
+}
+
+uint64_t EventHub::latest_id() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return events_.empty() ? 0 : events_.back()->frame_id;
+}
+
+void EventHub::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        running_ = false;
+    }
+    cv_.notify_all();
+}
@@ -0,0 +1,65 @@
+#ifndef EVENT_HUB_HPP
+#define EVENT_HUB_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// One detection event, already framed for Server-Sent Events
+// ("id: <frame_id>\ndata: <json>\n\n"), shared read-only by every subscriber.
+struct SseEvent
+{
+    uint64_t    seq = 0;        // publish order, gaps = events a subscriber missed
+    uint64_t    frame_id = 0;   // the SSE id, what EventSource sends back as Last-Event-ID
+    std::string text;
+};
+using SseEventPtr = std::shared_ptr<const SseEvent>;
+
+// Detection push for /events. The detect thread publishes each message
+// once; subscribers (httplib workers) take them from a short backlog, so a
+// client that falls behind by less than the backlog still gets every
+// event, and one further behind skips to the oldest kept. Publishing never
+// waits for a subscriber.
+class EventHub
+{
+public:
+    explicit EventHub(size_t backlog = 64, int max_subscribers = 8);
+
+    // detect thread; builds the SSE frame only while someone listens
+    bool has_subscribers() const { return subscribers_.load(std::memory_order_relaxed) > 0; }
+    void publish(uint64_t frame_id, const char* json, size_t len);
+
+    // subscriber side; subscribe() fails when max_subscribers are connected,
+    // each holds an HTTP worker thread
+    bool subscribe();
+    void unsubscribe();
+    // first event with frame_id > after, null on timeout or stop()
+    SseEventPtr next(uint64_t after, int timeout_ms);
+    void count_missed(uint64_t n) { missed_.fetch_add(n, std::memory_order_relaxed); }
+    void stop();
+
+    uint64_t latest_id() const;   // frame id of the newest event, 0 if none
+    int      subscribers() const { return subscribers_.load(std::memory_order_relaxed); }
+    uint64_t published() const { return published_.load(std::memory_order_relaxed); }
+    uint64_t missed() const { return missed_.load(std::memory_order_relaxed); }
+
+private:
+    const size_t backlog_;
+    const int    max_subscribers_;
+
+    mutable std::mutex      mtx_;
+    std::condition_variable cv_;
+    std::deque<SseEventPtr> events_;   // oldest first
+    uint64_t                seq_ = 0;
+    bool                    running_ = true;
+
+    std::atomic<int>      subscribers_{0};
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> missed_{0};
+};
+
+#endif // EVENT_HUB_HPP
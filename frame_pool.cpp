@@ -0,0 +1,107 @@
+#include "frame_pool.hpp"
+
+//  FrameRef 
+FrameRef::FrameRef(const FrameRef& o)
+    : pool_(o.pool_)
+    , slot_(o.slot_)
+{
+    if (pool_) pool_->retain(slot_);
+}
+
+FrameRef::FrameRef(FrameRef&& o) noexcept
+    : pool_(o.pool_)
+    , slot_(o.slot_)
+{
+    o.pool_ = nullptr;
+    o.slot_ = -1;
+}
+
+FrameRef& FrameRef::operator=(const FrameRef& o)
+{
+    if (this != &o) {
+        if (o.pool_) o.pool_->retain(o.slot_);
+        reset();
+        pool_ = o.pool_;
+        slot_ = o.slot_;
+    }
+    return *this;
+}
+
+FrameRef& FrameRef::operator=(FrameRef&& o) noexcept
+{
+    if (this != &o) {
+        reset();
+        pool_ = o.pool_;
+        slot_ = o.slot_;
+        o.pool_ = nullptr;
+        o.slot_ = -1;
+    }
+    return *this;
+}
+
+FrameRef::~FrameRef()
+{
+    reset();
+}
+
+cv::Mat& FrameRef::mat()
+{
+    return pool_->slots_[slot_].mat;
+}
+
+const cv::Mat& FrameRef::mat() const
+{
+    return pool_->slots_[slot_].mat;
+}
+
+void FrameRef::reset()
+{
+    if (pool_) pool_->release(slot_);
+    pool_ = nullptr;
+    slot_ = -1;
+}
+
+//  FramePool 
+FramePool::FramePool(int num_slots, int width, int height, int type)
+    : num_slots_(num_slots)
+    , slots_(new Slot[num_slots])
+{
+    free_.reserve(num_slots);
+    for (int i = 0; i < num_slots; i++) {
+        slots_[i].mat.create(height, width, type);
+        free_.push_back(i);
+    }
+}
+
+FrameRef FramePool::acquire()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (free_.empty())
+        return FrameRef();
+
+    int slot = free_.back();
+    free_.pop_back();
+    slots_[slot].refs.store(1, std::memory_order_relaxed);
+    return FrameRef(this, slot);
+}
+
+int FramePool::free_slots()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return (int)free_.size();
+}
+
+void FramePool::retain(int slot)
+{
+    slots_[slot].refs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FramePool::release(int slot)
+{
+    // acq_rel: the last reader's accesses happen-before the next writer
+    if (slots_[slot].refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    free_.push_back(slot);
+}
@@ -0,0 +1,77 @@
+#ifndef FRAME_POOL_HPP
+#define FRAME_POOL_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+class FramePool;
+
+// Reference-counted handle to one pool slot. Copying shares the slot,
+// the slot goes back to the pool when the last handle is dropped.
+// Do not keep cv::Mat headers of mat() alive past the handle: the
+// pixels are rewritten as soon as the slot is reacquired.
+class FrameRef
+{
+public:
+    FrameRef() = default;
+    FrameRef(const FrameRef& o);
+    FrameRef(FrameRef&& o) noexcept;
+    FrameRef& operator=(const FrameRef& o);
+    FrameRef& operator=(FrameRef&& o) noexcept;
+    ~FrameRef();
+
+    cv::Mat&       mat();
+    const cv::Mat& mat() const;
+
+    bool empty() const { return pool_ == nullptr; }
+    explicit operator bool() const { return pool_ != nullptr; }
+    void reset();
+
+private:
+    friend class FramePool;
+    FrameRef(FramePool* pool, int slot) : pool_(pool), slot_(slot) {}
+
+    FramePool* pool_ = nullptr;
+    int        slot_ = -1;
+};
+
+// Fixed set of preallocated frames shared between capture and readers.
+// After construction no further allocation happens as long as the
+// capture backend writes into the slot's Mat without resizing it.
+class FramePool
+{
+public:
+    FramePool(int num_slots, int width, int height, int type = CV_8UC3);
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // empty ref if every slot is still held by someone
+    FrameRef acquire();
+
+    int size() const { return num_slots_; }
+    int free_slots();
+
+private:
+    friend class FrameRef;
+
+    struct Slot {
+        cv::Mat          mat;
+        std::atomic<int> refs{0};
+    };
+
+    void retain(int slot);
+    void release(int slot);
+
+    int                     num_slots_;
+    std::unique_ptr<Slot[]> slots_;
+
+    std::mutex       mtx_;
+    std::vector<int> free_;   // capacity == num_slots_, never reallocates
+};
+
+#endif // FRAME_POOL_HPP
@@ -0,0 +1,414 @@
+#include "frame_source.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+//  FramePacer
+void FramePacer::set_fps(double fps)
+{
+    interval_ = (fps > 0.0)
+        ? std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / fps))
+        : clock::duration(0);
+}
+
+void FramePacer::wait()
+{
+    if (interval_.count() == 0)
+        return;
+
+    clock::time_point now = clock::now();
+    if (!started_) {
+        started_ = true;
+        next_ = now + interval_;
+        return;
+    }
+    if (next_ > now)
+        std::this_thread::sleep_until(next_);
+    else
+        next_ = now;   // behind: don't burst to catch up
+    next_ += interval_;
+}
+
+void FramePacer::wait_until_offset(double s)
+{
+    if (!started_) {
+        started_ = true;
+        t0_ = clock::now();
+        return;
+    }
+    std::this_thread::sleep_until(
+        t0_ + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(s)));
+}
+
+// into the caller's slot without reallocating it
+static void fit_into(const cv::Mat& src, cv::Mat& dst, int width, int height)
+{
+    if (src.cols == width && src.rows == height)
+        src.copyTo(dst);
+    else
+        cv::resize(src, dst, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+}
+
+//  GStreamer
+class GstSource : public FrameSource
+{
+public:
+    explicit GstSource(const SourceConfig& cfg) : cfg_(cfg) {}
+
+    bool open()
+    {
+        return cap_.open(cfg_.path, cv::CAP_GSTREAMER) && cap_.isOpened();
+    }
+
+    // the pipeline caps give width x height BGR: read straight into the slot
+    bool read(cv::Mat& frame) override
+    {
+        return cap_.read(frame) && !frame.empty();
+    }
+
+    std::string describe() const override { return "gst: " + cfg_.path; }
+
+private:
+    SourceConfig     cfg_;
+    cv::VideoCapture cap_;
+};
+
+//  video file
+class FileSource : public FrameSource
+{
+public:
+    explicit FileSource(const SourceConfig& cfg) : cfg_(cfg) {}
+
+    bool open()
+    {
+        if (!cap_.open(cfg_.path, cv::CAP_ANY) || !cap_.isOpened())
+            return false;
+        native_ = (int)cap_.get(cv::CAP_PROP_FRAME_WIDTH) == cfg_.width &&
+                  (int)cap_.get(cv::CAP_PROP_FRAME_HEIGHT) == cfg_.height;
+        double fps = cfg_.fps;
+        if (fps < 0.0) {
+            fps = cap_.get(cv::CAP_PROP_FPS);
+            if (!(fps > 0.0 && fps < 1000.0))
+                fps = 30.0;
+        }
+        pacer_.set_fps(fps);
+        return true;
+    }
+
+    bool read(cv::Mat& frame) override
+    {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool ok = native_ ? cap_.read(frame) : cap_.read(scratch_);
+            if (ok && !(native_ ? frame.empty() : scratch_.empty())) {
+                if (!native_)
+                    fit_into(scratch_, frame, cfg_.width, cfg_.height);
+                pacer_.wait();
+                return true;
+            }
+            if (!cfg_.loop || !cap_.open(cfg_.path, cv::CAP_ANY))
+                return false;
+        }
+        return false;
+    }
+
+    std::string describe() const override { return "file: " + cfg_.path; }
+
+private:
+    SourceConfig     cfg_;
+    cv::VideoCapture cap_;
+    bool             native_ = false;   // decoder output already has the frame size
+    cv::Mat          scratch_;
+    FramePacer       pacer_;
+};
+
+//  image directory
+class DirSource : public FrameSource
+{
+public:
+    explicit DirSource(const SourceConfig& cfg)
+        : cfg_(cfg), pacer_(cfg.fps < 0.0 ? 30.0 : cfg.fps) {}
+
+    bool open()
+    {
+        std::vector<std::string> all;
+        cv::glob(cfg_.path + "/*", all, false);
+        for (size_t i = 0; i < all.size(); i++) {
+            std::string ext = all[i].substr(all[i].find_last_of('.') + 1);
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (ext == "jpg" || ext == "jpeg" || ext == "png" || ext == "bmp")
+                files_.push_back(all[i]);
+        }
+        std::sort(files_.begin(), files_.end());
+        return !files_.empty();
+    }
+
+    bool read(cv::Mat& frame) override
+    {
+        while (next_ < files_.size() || (cfg_.loop && !files_.empty())) {
+            if (next_ == files_.size())
+                next_ = 0;
+            scratch_ = cv::imread(files_[next_++], cv::IMREAD_COLOR);
+            if (scratch_.empty()) {
+                std::cerr << "[SRC] skipping unreadable " << files_[next_ - 1] << "\n";
+                continue;
+            }
+            fit_into(scratch_, frame, cfg_.width, cfg_.height);
+            pacer_.wait();
+            return true;
+        }
+        return false;
+    }
+
+    std::string describe() const override
+    {
+        return "dir: " + cfg_.path + " (" + std::to_string(files_.size()) + " images)";
+    }
+
+private:
+    SourceConfig             cfg_;
+    std::vector<std::string> files_;
+    size_t                   next_ = 0;
+    cv::Mat                  scratch_;
+    FramePacer               pacer_;
+};
+
+//  synthetic
+// Textured background with a few "people" (upright blobs) walking across
+// at seeded speeds, plus a stretch with nobody in view every 300 frames
+// so the motion gate and adaptive scheduling see both cases.
+class SynthSource : public FrameSource
+{
+public:
+    explicit SynthSource(const SourceConfig& cfg)
+        : cfg_(cfg), pacer_(cfg.fps < 0.0 ? 30.0 : cfg.fps) {}
+
+    bool open()
+    {
+        uint32_t s = cfg_.seed ? cfg_.seed : 1;
+        bg_.create(cfg_.height, cfg_.width, CV_8UC3);
+        for (int y = 0; y < bg_.rows; y++) {
+            uchar* p = bg_.ptr(y);
+            for (int x = 0; x < bg_.cols; x++) {
+                int v = 60 + (x * 80) / bg_.cols + (y * 40) / bg_.rows + (int)(rnd(s) % 16);
+                p[3 * x + 0] = (uchar)v;
+                p[3 * x + 1] = (uchar)(v + 10);
+                p[3 * x + 2] = (uchar)(v + 5);
+            }
+        }
+        for (int i = 0; i < kWalkers; i++) {
+            Walker& w = walkers_[i];
+            w.h     = cfg_.height / 4 + (int)(rnd(s) % (uint32_t)(cfg_.height / 3));
+            w.w     = w.h * 2 / 5;
+            w.y     = (int)(rnd(s) % (uint32_t)std::max(1, cfg_.height - w.h));
+            w.speed = 1 + (int)(rnd(s) % 6);
+            w.phase = (int)(rnd(s) % 1000);
+            w.color = cv::Scalar(40 + rnd(s) % 180, 40 + rnd(s) % 180, 40 + rnd(s) % 180);
+        }
+        return true;
+    }
+
+    bool read(cv::Mat& frame) override
+    {
+        bg_.copyTo(frame);
+        const bool empty_scene = (n_ % 300) >= 240;
+        if (!empty_scene) {
+            const int span = cfg_.width + 2 * cfg_.width / 4;
+            for (int i = 0; i < kWalkers; i++) {
+                const Walker& w = walkers_[i];
+                int x = (int)((w.phase + n_ * w.speed) % span) - cfg_.width / 4;
+                cv::rectangle(frame, cv::Rect(x, w.y + w.h / 5, w.w, w.h * 4 / 5), w.color, -1);
+                cv::circle(frame, cv::Point(x + w.w / 2, w.y + w.h / 10), w.h / 10, w.color, -1);
+            }
+        }
+        n_++;
+        pacer_.wait();
+        return true;
+    }
+
+    std::string describe() const override { return "synth: seed " + std::to_string(cfg_.seed); }
+
+private:
+    static const int kWalkers = 3;
+
+    struct Walker {
+        int y = 0, w = 0, h = 0, speed = 1, phase = 0;
+        cv::Scalar color;
+    };
+
+    static uint32_t rnd(uint32_t& s)   // xorshift32
+    {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+    }
+
+    SourceConfig cfg_;
+    cv::Mat      bg_;
+    Walker       walkers_[kWalkers];
+    int64_t      n_ = 0;
+    FramePacer   pacer_;
+};
+
+//  timestamped replay
+// Wraps an unpaced file/dir source. <path>.ts holds one capture time in
+// seconds per frame (any origin), e.g. from a recording's
+// CLOCK_MONOTONIC stamps. Frames beyond the last stamp (a clip longer
+// than its .ts, or looped passes) keep the last interval.
+class ReplaySource : public FrameSource
+{
+public:
+    ReplaySource(const SourceConfig& cfg, std::unique_ptr<FrameSource> inner)
+        : cfg_(cfg), inner_(std::move(inner)), pacer_(cfg.fps > 0.0 ? cfg.fps : 0.0) {}
+
+    bool open()
+    {
+        std::ifstream in(cfg_.path + ".ts");
+        if (!in) {
+            std::cerr << "[SRC] replay needs " << cfg_.path << ".ts\n";
+            return false;
+        }
+        double t;
+        while (in >> t)
+            ts_.push_back(t);
+        return ts_.size() >= 2;
+    }
+
+    bool read(cv::Mat& frame) override
+    {
+        if (!inner_->read(frame))
+            return false;
+
+        if (cfg_.fps < 0.0) {
+            // recorded timing, clamped to the last interval past the end
+            const size_t last = ts_.size() - 1;
+            double off;
+            if (n_ <= last)
+                off = ts_[n_] - ts_[0];
+            else
+                off = (ts_[last] - ts_[0]) + (double)(n_ - last) * (ts_[last] - ts_[last - 1]);
+            pacer_.wait_until_offset(off);
+        } else {
+            pacer_.wait();
+        }
+        n_++;
+        return true;
+    }
+
+    std::string describe() const override
+    {
+        const char* pace = cfg_.fps < 0.0 ? "recorded" : (cfg_.fps == 0.0 ? "fast" : "fixed");
+        return "replay: " + cfg_.path + " (" + pace + " timing, " +
+               std::to_string(ts_.size()) + " stamps)";
+    }
+
+private:
+    SourceConfig                 cfg_;
+    std::unique_ptr<FrameSource> inner_;
+    std::vector<double>          ts_;
+    size_t                       n_ = 0;
+    FramePacer                   pacer_;
+};
+
+//  frame limit
+class LimitSource : public FrameSource
+{
+public:
+    LimitSource(std::unique_ptr<FrameSource> inner, int64_t frames)
+        : inner_(std::move(inner)), left_(frames) {}
+
+    bool read(cv::Mat& frame) override
+    {
+        if (left_ <= 0)
+            return false;
+        left_--;
+        return inner_->read(frame);
+    }
+
+    std::string describe() const override { return inner_->describe(); }
+
+private:
+    std::unique_ptr<FrameSource> inner_;
+    int64_t                      left_;
+};
+
+bool parse_source(const std::string& spec, SourceConfig& cfg)
+{
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    std::string arg  = (colon == std::string::npos) ? std::string() : spec.substr(colon + 1);
+
+    if (kind == "camera") {
+        cfg.kind = "gst";   // path keeps the default pipeline
+        return true;
+    }
+    if (kind == "synth") {
+        cfg.kind = kind;
+        if (!arg.empty())
+            cfg.seed = (uint32_t)std::strtoul(arg.c_str(), nullptr, 10);
+        return true;
+    }
+    if ((kind == "gst" || kind == "file" || kind == "dir" || kind == "replay") && !arg.empty()) {
+        cfg.kind = kind;
+        cfg.path = arg;
+        return true;
+    }
+    return false;
+}
+
+std::unique_ptr<FrameSource> open_frame_source(const SourceConfig& cfg)
+{
+    std::unique_ptr<FrameSource> src;
+
+    if (cfg.kind == "gst") {
+        std::unique_ptr<GstSource> s(new GstSource(cfg));
+        if (s->open())
+            src = std::move(s);
+    } else if (cfg.kind == "file") {
+        std::unique_ptr<FileSource> s(new FileSource(cfg));
+        if (s->open())
+            src = std::move(s);
+    } else if (cfg.kind == "dir") {
+        std::unique_ptr<DirSource> s(new DirSource(cfg));
+        if (s->open())
+            src = std::move(s);
+    } else if (cfg.kind == "synth") {
+        std::unique_ptr<SynthSource> s(new SynthSource(cfg));
+        if (s->open())
+            src = std::move(s);
+    } else if (cfg.kind == "replay") {
+        // the media plays unpaced, the stamps set the pace
+        SourceConfig media = cfg;
+        media.fps = 0.0;
+        std::unique_ptr<FrameSource> inner;
+        std::unique_ptr<DirSource> d(new DirSource(media));
+        if (d->open()) {
+            inner = std::move(d);
+        } else {
+            std::unique_ptr<FileSource> f(new FileSource(media));
+            if (f->open())
+                inner = std::move(f);
+        }
+        if (inner) {
+            std::unique_ptr<ReplaySource> s(new ReplaySource(cfg, std::move(inner)));
+            if (s->open())
+                src = std::move(s);
+        }
+    } else {
+        std::cerr << "[SRC] unknown source kind " << cfg.kind << "\n";
+        return src;
+    }
+
+    if (!src) {
+        std::cerr << "[SRC] failed to open " << cfg.kind << ": " << cfg.path << "\n";
+        return src;
+    }
+    if (cfg.frames > 0)
+        src.reset(new LimitSource(std::move(src), cfg.frames));
+    return src;
+}
@@ -0,0 +1,69 @@
+#ifndef FRAME_SOURCE_HPP
+#define FRAME_SOURCE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+struct SourceConfig
+{
+    // gst    GStreamer pipeline in path (the Pi camera by default)
+    // file   video file
+    // dir    directory of .jpg/.png/.bmp images, in name order
+    // synth  deterministic generated scene, frame n only depends on (seed, n)
+    // replay file or dir played with the timing recorded in <path>.ts
+    std::string kind = "gst";
+    std::string path;
+    int         width  = 640;    // frames are delivered at this size, BGR
+    int         height = 480;
+    double      fps    = -1.0;   // <0: natural rate (file: container fps, dir/synth: 30,
+                                 // replay: recorded), 0: as fast as possible, >0: fixed
+    bool        loop   = false;  // file/dir/replay: start over at the end
+    int64_t     frames = 0;      // stop after N frames, 0 = until the source ends
+    uint32_t    seed   = 1;      // synth
+};
+
+// Where camera_stage gets its frames from. read() fills a preallocated
+// width x height BGR Mat (a FramePool slot) in place and blocks until the
+// frame is due, so everything downstream runs the same whatever the source.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    // false at the end of the stream or on error
+    virtual bool read(cv::Mat& frame) = 0;
+    virtual std::string describe() const = 0;
+};
+
+// "kind[:path]" as given on the command line, e.g. file:clip.mp4, synth:7
+bool parse_source(const std::string& spec, SourceConfig& cfg);
+
+// null if the source can't be opened (message on stderr)
+std::unique_ptr<FrameSource> open_frame_source(const SourceConfig& cfg);
+
+// Sleeps until the next frame is due. interval 0 never sleeps; a late
+// frame does not shorten the following intervals.
+class FramePacer
+{
+public:
+    explicit FramePacer(double fps = 0.0) { set_fps(fps); }
+
+    void set_fps(double fps);
+    void wait();                       // fixed interval
+    void wait_until_offset(double s);  // s seconds after the first frame (replay)
+
+private:
+    typedef std::chrono::steady_clock clock;
+
+    clock::duration   interval_{0};
+    clock::time_point next_;
+    clock::time_point t0_;
+    bool              started_ = false;
+};
+
+#endif // FRAME_SOURCE_HPP
@@ -0,0 +1,445 @@
+#include "jpeg_encoder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef HAVE_LIBJPEG
+#include <jpeglib.h>
+#endif
+
+//  EncodeStats
+const int EncodeStats::kEdgesUs[EncodeStats::kBuckets] = {
+    1000, 2000, 3000, 4000, 5000, 6000, 8000, 10000, 15000, 20000, 30000, 1 << 30
+};
+
+double EncodeStats::quantile_ms(double q) const
+{
+    if (count == 0)
+        return 0.0;
+    uint64_t target = (uint64_t)(q * (double)count);
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++)
+    {
+        seen += buckets[i];
+        if (seen > target)
+            return (i + 1 < kBuckets ? kEdgesUs[i] : kEdgesUs[i - 1]) / 1000.0;
+    }
+    return kEdgesUs[kBuckets - 2] / 1000.0;
+}
+
+//  Codec
+// Encoder state owned by the encoder thread, reused for every frame.
+#ifdef HAVE_LIBJPEG
+struct JpegEncoder::Codec
+{
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr       jerr;
+    unsigned char*       buf  = nullptr;   // malloc'd, libjpeg may replace it
+    unsigned long        cap  = 0;
+    std::vector<unsigned char> rgb;         // one row, only without JCS_EXT_BGR
+
+    Codec()
+    {
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_compress(&cinfo);
+    }
+    ~Codec()
+    {
+        jpeg_destroy_compress(&cinfo);
+        std::free(buf);
+    }
+
+    // out points into buf, valid until the next encode
+    bool encode(const cv::Mat& bgr, int quality, const unsigned char*& out, size_t& out_len)
+    {
+        if (bgr.empty() || bgr.type() != CV_8UC3)
+            return false;
+
+        // a destination big enough for any sane frame: libjpeg only
+        // reallocates (and hands back a new buffer) past this size
+        if (!buf)
+        {
+            cap = (unsigned long)bgr.cols * bgr.rows;
+            buf = (unsigned char*)std::malloc(cap);
+        }
+        unsigned char* dst  = buf;
+        unsigned long  size = cap;
+        jpeg_mem_dest(&cinfo, &dst, &size);
+
+        cinfo.image_width      = bgr.cols;
+        cinfo.image_height     = bgr.rows;
+        cinfo.input_components = 3;
+#ifdef JCS_EXTENSIONS
+        cinfo.in_color_space = JCS_EXT_BGR;
+#else
+        cinfo.in_color_space = JCS_RGB;
+        rgb.resize((size_t)bgr.cols * 3);
+#endif
+        jpeg_set_defaults(&cinfo);
+        jpeg_set_quality(&cinfo, quality, TRUE);
+        cinfo.dct_method = JDCT_IFAST;
+
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height)
+        {
+            JSAMPROW row = const_cast<JSAMPROW>(bgr.ptr<unsigned char>(cinfo.next_scanline));
+#ifndef JCS_EXTENSIONS
+            const unsigned char* s = row;
+            for (int x = 0; x < bgr.cols; x++)
+            {
+                rgb[x * 3 + 0] = s[x * 3 + 2];
+                rgb[x * 3 + 1] = s[x * 3 + 1];
+                rgb[x * 3 + 2] = s[x * 3 + 0];
+            }
+            row = rgb.data();
+#endif
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+
+        if (dst != buf)
+        {
+            // outgrew our buffer: keep libjpeg's larger one for next time
+            std::free(buf);
+            buf = dst;
+            cap = size;
+        }
+        out     = dst;
+        out_len = size;
+        return true;
+    }
+};
+#else
+struct JpegEncoder::Codec
+{
+    std::vector<int>           params;
+    std::vector<unsigned char> buf;
+
+    bool encode(const cv::Mat& bgr, int quality, const unsigned char*& out, size_t& out_len)
+    {
+        if (params.empty())
+            params = { cv::IMWRITE_JPEG_QUALITY, quality };
+        if (!cv::imencode(".jpg", bgr, buf, params))
+            return false;
+        out     = buf.data();
+        out_len = buf.size();
+        return true;
+    }
+};
+#endif
+
+//  renditions
+static const char* const kRenditionNames[REND_COUNT] = { "full", "thumb", "annot" };
+
+const char* rendition_name(Rendition r)
+{
+    return (r >= 0 && r < REND_COUNT) ? kRenditionNames[r] : "?";
+}
+
+bool parse_rendition(const std::string& name, Rendition& r)
+{
+    if (name.empty()) {
+        r = REND_FULL;
+        return true;
+    }
+    for (int i = 0; i < REND_COUNT; i++) {
+        if (name == kRenditionNames[i]) {
+            r = (Rendition)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void draw_boxes(cv::Mat& img, const std::vector<TargetBox>& boxes)
+{
+    char label[32];
+    for (size_t i = 0; i < boxes.size(); i++) {
+        const TargetBox& b = boxes[i];
+        const cv::Scalar color = (b.cate == 0) ? cv::Scalar(0, 255, 0) : cv::Scalar(0, 200, 255);
+        cv::rectangle(img, cv::Point(b.x1, b.y1), cv::Point(b.x2, b.y2), color, 2);
+        if (b.cate == 0)
+            std::snprintf(label, sizeof(label), "person %.2f", b.score);
+        else
+            std::snprintf(label, sizeof(label), "cls%d %.2f", b.cate, b.score);
+        cv::putText(img, label, cv::Point(b.x1 + 2, std::max(b.y1 - 4, 12)),
+                    cv::FONT_HERSHEY_SIMPLEX, 0.45, color, 1);
+    }
+}
+
+//  JpegEncoder
+JpegEncoder::JpegEncoder(int quality, const std::string& boundary, int thumb_w, int thumb_h)
+    : quality_(quality)
+    , boundary_(boundary)
+    , thumb_w_(thumb_w)
+    , thumb_h_(thumb_h)
+{
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    stop();
+}
+
+void JpegEncoder::set_listener(Listener l)
+{
+    listener_ = std::move(l);
+}
+
+void JpegEncoder::start()
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (running_)
+        return;
+    running_ = true;
+    thread_ = std::thread(&JpegEncoder::run, this);
+}
+
+void JpegEncoder::stop()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        running_ = false;
+        pending_.reset();
+        annot_frame_.reset();
+    }
+    cv_work_.notify_all();
+    cv_done_.notify_all();
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void JpegEncoder::offer(uint64_t frame_id, const FrameRef& frame)
+{
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!running_)
+            return;
+        pending_    = frame;   // drops the previous slot reference
+        pending_id_ = frame_id;
+        wake = out_[REND_FULL].wanted() || out_[REND_THUMB].wanted();
+    }
+    if (wake)
+        cv_work_.notify_one();
+}
+
+void JpegEncoder::offer_annotated(uint64_t frame_id, const FrameRef& frame,
+                                  const std::vector<TargetBox>& boxes)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!running_ || !out_[REND_ANNOT].wanted()) {
+            annot_frame_.reset();   // don't pin a pool slot for nobody
+            return;
+        }
+        annot_frame_ = frame;
+        annot_id_    = frame_id;
+        annot_boxes_.assign(boxes.begin(), boxes.end());
+    }
+    cv_work_.notify_one();
+}
+
+bool JpegEncoder::wants(Rendition r) const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return out_[r].wanted();
+}
+
+JpegFramePtr JpegEncoder::wait_newer(uint64_t after_id, int timeout_ms, Rendition r)
+{
+    std::unique_lock<std::mutex> lk(mtx_);
+    Output& o = out_[r];
+    if (running_ && o.latest_id <= after_id)
+    {
+        o.waiting++;
+        cv_work_.notify_one();   // demand
+        cv_done_.wait_for(lk, std::chrono::milliseconds(timeout_ms), [this, &o, after_id] {
+            return !running_ || o.latest_id > after_id;
+        });
+        o.waiting--;
+    }
+    if (o.latest_id <= after_id)
+        return JpegFramePtr();
+    return o.latest;
+}
+
+void JpegEncoder::request(Rendition r)
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        out_[r].requested = true;
+    }
+    cv_work_.notify_one();
+}
+
+JpegFramePtr JpegEncoder::latest(Rendition r) const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return out_[r].latest;
+}
+
+uint64_t JpegEncoder::latest_id(Rendition r) const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return out_[r].latest_id;
+}
+
+EncodeStats JpegEncoder::stats() const
+{
+    std::lock_guard<std::mutex> lk(mtx_);
+    return stats_;
+}
+
+bool JpegEncoder::has_work(Rendition r) const
+{
+    const Output& o = out_[r];
+    if (!o.wanted())
+        return false;
+    if (r == REND_ANNOT)
+        return annot_frame_ && annot_id_ > o.latest_id;
+    return pending_ && pending_id_ > o.latest_id;
+}
+
+// Recycling: a frame only the ring still references is neither latest
+// nor held by a client (they can only get one through latest, under the
+// lock), so it can be rewritten outside the lock.
+static const size_t kFrameRing = 4;
+
+void JpegEncoder::publish(Rendition r, uint64_t id, const unsigned char* jpg, size_t len,
+                          uint64_t us)
+{
+    std::vector<std::shared_ptr<JpegFrame>>& ring = out_[r].ring;
+
+    std::shared_ptr<JpegFrame> out;
+    for (size_t i = 0; i < ring.size() && !out; i++)
+    {
+        if (ring[i].use_count() == 1)
+            out = ring[i];
+    }
+    if (!out)
+    {
+        // every recycled frame is still being sent: replace the oldest
+        out = std::make_shared<JpegFrame>();
+        if (ring.size() < kFrameRing)
+            ring.push_back(out);
+        else
+        {
+            std::rotate(ring.begin(), ring.begin() + 1, ring.end());
+            ring.back() = out;
+        }
+    }
+
+    char head[128];
+    int  head_len = std::snprintf(head, sizeof(head),
+                                  "--%s\r\nContent-Type: image/jpeg\r\n"
+                                  "Content-Length: %zu\r\n\r\n",
+                                  boundary_.c_str(), len);
+    out->frame_id = id;
+    out->part.assign(head, head_len);
+    out->jpeg_off = out->part.size();
+    out->jpeg_len = len;
+    out->part.append((const char*)jpg, len);
+    out->part.append("\r\n", 2);
+
+    JpegFramePtr shared = out;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        Output& o = out_[r];
+        o.latest    = shared;
+        o.latest_id = id;
+        o.requested = false;
+
+        int b = 0;
+        while (b + 1 < EncodeStats::kBuckets && (int)us >= EncodeStats::kEdgesUs[b])
+            b++;
+        stats_.buckets[b]++;
+        stats_.count++;
+        stats_.total_us += us;
+        stats_.bytes += len;
+    }
+    cv_done_.notify_all();   // every waiting client, one broadcast
+    if (listener_)
+        listener_(r, shared);
+}
+
+void JpegEncoder::run()
+{
+    Codec codec;
+    cv::Mat thumb;
+    cv::Mat annot;
+    std::vector<TargetBox> boxes;
+
+    for (;;)
+    {
+        FrameRef cam, det;
+        uint64_t cam_id = 0, det_id = 0;
+        bool     want[REND_COUNT];
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_work_.wait(lk, [this] {
+                return !running_ || has_work(REND_FULL) || has_work(REND_THUMB) ||
+                       has_work(REND_ANNOT);
+            });
+            if (!running_)
+                break;
+            for (int r = 0; r < REND_COUNT; r++)
+                want[r] = has_work((Rendition)r);
+
+            if (want[REND_FULL] || want[REND_THUMB])
+            {
+                cam    = pending_;   // stays pending for a rendition asked for later
+                cam_id = pending_id_;
+            }
+            if (want[REND_ANNOT])
+            {
+                det    = std::move(annot_frame_);
+                det_id = annot_id_;
+                boxes.swap(annot_boxes_);
+            }
+        }
+
+        // each rendition wanted is made once from this frame, whatever the viewer count
+        const int last_cam = want[REND_THUMB] ? REND_THUMB : REND_FULL;
+        for (int r = 0; r < REND_COUNT; r++)
+        {
+            if (!want[r])
+                continue;
+
+            auto t0 = std::chrono::steady_clock::now();
+            const cv::Mat* src = nullptr;
+            uint64_t       id  = cam_id;
+            if (r == REND_FULL)
+            {
+                src = &cam.mat();
+            }
+            else if (r == REND_THUMB)
+            {
+                cv::resize(cam.mat(), thumb, cv::Size(thumb_w_, thumb_h_), 0, 0, cv::INTER_AREA);
+                src = &thumb;
+            }
+            else
+            {
+                det.mat().copyTo(annot);   // the slot is shared with capture/detection
+                det.reset();
+                draw_boxes(annot, boxes);
+                src = &annot;
+                id  = det_id;
+            }
+
+            const unsigned char* jpg = nullptr;
+            size_t jpg_len = 0;
+            if (!codec.encode(*src, quality_, jpg, jpg_len))
+                continue;
+            uint64_t us = (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                              std::chrono::steady_clock::now() - t0).count();
+            if (r == last_cam)
+                cam.reset();   // slot back to the pool before waking consumers
+            publish((Rendition)r, id, jpg, jpg_len, us);
+        }
+    }
+}
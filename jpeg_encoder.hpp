@@ -0,0 +1,152 @@
+#ifndef JPEG_ENCODER_HPP
+#define JPEG_ENCODER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "frame_pool.hpp"
+#include "yolo-fastestv2.h"
+
+// Encode-time histogram, fixed bucket edges in microseconds.
+struct EncodeStats
+{
+    static const int kBuckets = 12;
+    static const int kEdgesUs[kBuckets];   // upper edge of each bucket, last = open
+
+    uint64_t count = 0;
+    uint64_t total_us = 0;
+    uint64_t bytes = 0;      // JPEG output, all renditions
+    uint64_t buckets[kBuckets] = {};
+
+    // upper bucket edge below which q (0..1) of the encodes fall
+    double quantile_ms(double q) const;
+};
+
+// One encoded frame, shared read-only by every HTTP client. part is the
+// complete multipart/x-mixed-replace part (boundary line, headers, JPEG,
+// CRLF), built once so a stream client sends it with a single write.
+struct JpegFrame
+{
+    uint64_t    frame_id = 0;
+    std::string part;
+    size_t      jpeg_off = 0;
+    size_t      jpeg_len = 0;
+
+    const char* jpeg() const { return part.data() + jpeg_off; }
+};
+typedef std::shared_ptr<const JpegFrame> JpegFramePtr;
+
+// Variants of the camera stream, ?r=full|thumb|annot
+enum Rendition
+{
+    REND_FULL = 0,   // camera frame as is
+    REND_THUMB,      // downscaled
+    REND_ANNOT,      // detection boxes drawn, from the frame's own result
+    REND_COUNT
+};
+
+const char* rendition_name(Rendition r);
+// "full" / "thumb" / "annot", empty = full; false if unknown
+bool parse_rendition(const std::string& name, Rendition& r);
+
+// Demand-driven JPEG stage on its own thread.
+//
+// The camera offers every frame and the detect stage offers each frame
+// with its boxes (neither blocks, an older frame not yet picked up is
+// simply replaced). A rendition is only produced when a consumer is
+// waiting for one newer than the last, so with no viewer nothing is
+// rendered or encoded, and each (frame, rendition) pair is encoded at
+// most once whatever the number of viewers. Uses libjpeg(-turbo) directly
+// with a reused output buffer when built with HAVE_LIBJPEG, cv::imencode
+// otherwise.
+//
+// Each JPEG is published once as a JpegFramePtr: consumers share it
+// without copying or holding the lock, and are all woken by one broadcast.
+// Frames no client holds any more are recycled, so steady state does not
+// allocate.
+class JpegEncoder
+{
+public:
+    // called on the encoder thread after each publish, keep it short
+    typedef std::function<void(Rendition, const JpegFramePtr&)> Listener;
+
+    JpegEncoder(int quality, const std::string& boundary,
+                int thumb_w = 320, int thumb_h = 240);
+    ~JpegEncoder();
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    void set_listener(Listener l);   // before start()
+    void start();
+    void stop();   // wakes waiting consumers
+
+    // capture thread: keeps a reference to the slot until it is encoded or replaced
+    void offer(uint64_t frame_id, const FrameRef& frame);
+    // detect thread: frame + its final boxes; dropped unless REND_ANNOT is wanted
+    void offer_annotated(uint64_t frame_id, const FrameRef& frame,
+                         const std::vector<TargetBox>& boxes);
+    bool wants(Rendition r) const;
+
+    // Blocks until a JPEG of a frame newer than after_id exists.
+    // Null on timeout or stop.
+    JpegFramePtr wait_newer(uint64_t after_id, int timeout_ms, Rendition r = REND_FULL);
+    // non-blocking demand: produce r from the next frame, delivered to the listener
+    void request(Rendition r);
+
+    JpegFramePtr latest(Rendition r = REND_FULL) const;   // may be null
+    uint64_t     latest_id(Rendition r = REND_FULL) const;
+    EncodeStats stats() const;
+
+private:
+    struct Codec;
+
+    struct Output
+    {
+        JpegFramePtr latest;
+        uint64_t     latest_id = 0;
+        int          waiting   = 0;       // consumers blocked in wait_newer()
+        bool         requested = false;   // request() since the last publish
+        std::vector<std::shared_ptr<JpegFrame>> ring;   // encoder thread only
+
+        bool wanted() const { return waiting > 0 || requested; }
+    };
+
+    void run();
+    bool has_work(Rendition r) const;   // mtx_ held
+    void publish(Rendition r, uint64_t id, const unsigned char* jpg, size_t len, uint64_t us);
+
+    int         quality_;
+    std::string boundary_;
+    int         thumb_w_;
+    int         thumb_h_;
+    Listener    listener_;
+
+    mutable std::mutex      mtx_;
+    std::condition_variable cv_work_;   // encoder: demand or new frame
+    std::condition_variable cv_done_;   // consumers: new JPEG
+    bool                    running_ = false;
+
+    FrameRef pending_;   // latest camera frame
+    uint64_t pending_id_ = 0;
+
+    FrameRef               annot_frame_;   // latest detected frame, only while wanted
+    uint64_t               annot_id_ = 0;
+    std::vector<TargetBox> annot_boxes_;
+
+    Output out_[REND_COUNT];
+
+    EncodeStats stats_;
+    std::thread thread_;
+};
+
+#endif // JPEG_ENCODER_HPP
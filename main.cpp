@@ -1,19 +1,35 @@
 #include <iostream>
 #include <vector>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
 #include <atomic>
 #include <chrono>
 #include <sstream>
 #include <iomanip>
 #include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <algorithm>
 
 #include <opencv2/opencv.hpp>
 #include <ncnn/net.h>
 
 #include "yolo-fastestv2.h"
 #include "audio_player.hpp"
+#include "frame_pool.hpp"
+#include "detector_pool.hpp"
+#include "tracker.hpp"
+#include "motion_gate.hpp"
+#include "tile_planner.hpp"
+#include "jpeg_encoder.hpp"
+#include "mjpeg_server.hpp"
+#include "frame_source.hpp"
+#include "metrics.hpp"
+#include "det_wire.hpp"
+#include "udp_sender.hpp"
+#include "event_hub.hpp"
+#include "pipeline.hpp"
 
 #define PERF_ENABLE
 #include "PerfLogger.hpp"         
@@ -22,17 +38,46 @@
 
 // CONFIG  
 static constexpr bool   kUseVulkan      = false;
-static constexpr int    kDetectEveryN   = 1;      // detect mỗi N frame mới
+static constexpr int    kDetectEveryN   = 1;      // detect mỗi N frame mới (fixed mode)
+static constexpr bool   kAdaptiveDetect = true;   // tracker decides when to run inference
+static constexpr int    kDetectMaxEvery = 10;     // adaptive: longest gap between inferences
+static constexpr int    kMotionPixel    = 18;     // gray level change that counts, override with --motion-pixel
+static constexpr float  kMotionArea     = 0.004f; // changed-pixel share = motion, --motion-area (0 = gate off)
+static constexpr int    kMotionMaxSkip  = 60;     // static scene: still re-detect every N frames (~2 s)
+static constexpr bool   kTiledDetect    = true;   // crop to zones / motion, --tiles 0 = always full frame
 static constexpr float  kDetThresh      = 0.30f;
 static constexpr float  kPersonConf     = 0.50f;
+static const std::vector<int> kDetClasses = { 0 };   // person only
 static constexpr int    kLogEveryMs     = 1000;
 
 static constexpr int    kHttpPort       = 8080;
 static constexpr int    kJpegQuality    = 75;     
-constexpr float SCALE_X = 640.0f / 352.0f;
-constexpr float SCALE_Y = 480.0f / 352.0f;
-
-// GStreamer pipeline (Pi camera)
+static constexpr int    kSnapshotPollMs = 10000;  // longest /snapshot.jpg?after= wait
+static constexpr int    kHttpThreads    = 16;     // each snapshot long poll / event subscriber holds one
+static constexpr int    kEventClients   = 8;      // /events subscribers, the rest of the pool stays free
+static constexpr int    kEventBacklog   = 64;     // events a reconnecting subscriber can catch up on
+static constexpr int    kEventKeepaliveMs = 15000;
+static const char*      kMjpegBoundary  = "frame";
+static constexpr int    kStreamPort     = 8081;   // epoll MJPEG server, /stream.mjpg
+static constexpr int    kStreamQueue    = 2;      // frames queued per viewer before dropping
+static const char*      kUdpDest        = "127.0.0.1:9001";   // ws_bridge.py; --udp host:port (repeatable, multicast ok)
+static constexpr int    kUdpSndBuf      = 256 * 1024;
+static constexpr int    kUdpMcastTtl    = 1;      // multicast stays on the local subnet
+static const char*      kAlertWav       = "/home/pi/person_detected.wav";   // --wav <path>
+static constexpr int    kAlertThrottleMs = 2000;  // shortest gap between alerts
+
+// --model <param> <bin>
+static const char*      kModelParam     = "/home/pi/models/yolo-fastestv2-opt.param";
+static const char*      kModelBin       = "/home/pi/models/yolo-fastestv2-opt.bin";
+
+static constexpr int    kFrameW         = 640;
+static constexpr int    kFrameH         = 480;
+
+// detector pool defaults, override with --workers N --threads M
+static constexpr int    kDetWorkers     = 1;
+static constexpr int    kDetThreads     = 4;
+
+// GStreamer pipeline (Pi camera), the default frame source; --source file:|dir:|synth|replay:
 static const std::string kPipeline =
     "libcamerasrc ! "
     "video/x-raw,width=640,height=480,framerate=30/1 ! "
@@ -42,10 +87,9 @@ static const std::string kPipeline =
 
 // DATA STRUCT 
 struct FramePacket {
-    cv::Mat frame;  
+    FrameRef frame;  
     uint64_t id = 0;
-    
-}
+};
 struct DetPacket {
     uint64_t frame_id = 0;
     std::vector<TargetBox> boxes;
@@ -53,226 +97,417 @@ struct DetPacket {
 };
 
 // SHARED STATE  
-// Camera -> Detect
-static std::mutex g_mtx_frame;
-static std::condition_variable g_cv_frame;
-static FramePacket g_latest_frame;
-static bool g_have_frame = false;
-
-// Detect -> Logic
-static std::mutex g_mtx_det;
-static std::condition_variable g_cv_det;
-static DetPacket g_latest_det;
-static bool g_have_det = false;
-
-// Latest JPEG for HTTP
-static std::mutex g_mtx_jpeg;
-static std::vector<uchar> g_latest_jpeg;
-static uint64_t g_latest_jpeg_id = 0;
+// Frame buffers (must outlive g_pipe), sized in main()
+static std::unique_ptr<FramePool> g_frame_pool;
+static std::unique_ptr<FrameSource> g_source;   // opened in main(), read by camera_stage only
+
+// Stage graph: camera -> dispatch -> detector pool -> detect -> logic, edges set up in main()
+static Pipeline g_pipe;
+static Edge<FramePacket>* g_frames = nullptr;              // camera -> dispatch, latest frame
+static Edge<DetPacket>* g_dets = nullptr;                  // detect -> logic, latest result
+static Edge<std::vector<TargetBox>>* g_tracks = nullptr;   // detect -> dispatch, boxes to keep in the tiles
+
+// Camera -> JPEG encoder -> HTTP (encodes only while someone is waiting), set up in main()
+static std::unique_ptr<JpegEncoder> g_jpeg;
+static std::unique_ptr<MjpegServer> g_stream;
+static std::unique_ptr<UdpSender> g_udp;   // detections, sent by detect_stage only
+static std::unique_ptr<AudioPlayer> g_audio;   // alerts, triggered by logic_stage only
+static EventHub g_events(kEventBacklog, kEventClients);   // detections pushed to /events
+
+// Detect scheduling: set by detect_stage (tracker), read by dispatch_stage
+static DetectScheduler g_sched(1);
+
+// DetResult.flags: inference skipped because nothing moved (in the zones), reuse the last result
+static constexpr uint32_t kFrameStatic = 1u;
 
 // Counters
 static std::atomic<uint64_t> g_cap_cnt{0};
 static std::atomic<uint64_t> g_det_cnt{0};
+static std::atomic<uint64_t> g_drop_cnt{0};   // captured with every pool slot held, never published
+static std::atomic<uint64_t> g_static_cnt{0}; // frames not inferred because the scene was static
+static std::atomic<uint64_t> g_infer_cnt{0};  // frames that ran inference
+
+// latency histograms for /metrics, recorded lock-free by the pipeline threads
+static LatencyHistogram g_hist_cap_det;   // frame captured -> decode + NMS done, inferred frames
+static LatencyHistogram g_hist_pp;        // preprocess (resize + tiles)
+static LatencyHistogram g_hist_infer;     // ncnn forward
+static LatencyHistogram g_hist_decode;    // predHandle + NMS
+static LatencyHistogram g_hist_udp;       // detection message send
+static LatencyHistogram g_hist_audio;     // detection published -> alert started
+
+// capture time by frame id; results trail capture by a few frames, far less than the ring
+static constexpr uint64_t kCapTimeRing = 64;
+static std::atomic<int64_t> g_cap_time_ns[kCapTimeRing];
 
 // Quit flag
 static std::atomic<bool> g_run{true};
 
+// captured frames detection never saw: no pool slot, or overwritten in the frames mailbox
+static uint64_t frames_dropped()
+{
+    return g_drop_cnt.load(std::memory_order_relaxed) + g_frames->dropped();
+}
+
 // UTILS 
 static inline double sec_since(const std::chrono::steady_clock::time_point& t0)
 {
     return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
 }
 
-// UDP sender  
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-
-class UdpSender {
-public:
-    UdpSender(const char* ip, int port) {
-        fd_ = ::socket(AF_INET, SOCK_DGRAM, 0);
-        if (fd_ < 0) {
-            std::perror("socket");
-            ok_ = false;
-            return;
-        }
-        std::memset(&addr_, 0, sizeof(addr_));
-        addr_.sin_family = AF_INET;
-        addr_.sin_port   = htons(port);
-        if (::inet_pton(AF_INET, ip, &addr_.sin_addr) != 1) {
-            std::perror("inet_pton");
-            ok_ = false;
-            return;
-        }
-        ok_ = true;
-    }
-
-    ~UdpSender() {
-        if (fd_ >= 0) ::close(fd_);
-    }
-
-    bool send_str(const std::string& s) {
-        if (!ok_) return false;
-        ssize_t n = ::sendto(fd_, s.data(), s.size(), 0,
-                             (struct sockaddr*)&addr_, sizeof(addr_));
-        return (n == (ssize_t)s.size());
-    }
-
-private:
-    int fd_{-1};
-    bool ok_{false};
-    struct sockaddr_in addr_;
-};
+// same time base as PerfLogger
+static inline double to_sec(const std::chrono::steady_clock::time_point& t)
+{
+    return std::chrono::duration<double>(t.time_since_epoch()).count();
+}
 
 // HTTP MJPEG SERVER 
 static void http_server_thread()
 {
     httplib::Server svr;
+    svr.new_task_queue = [] { return new httplib::ThreadPool(kHttpThreads); };
 
     // Snapshot
-    svr.Get("/snapshot.jpg", [](const httplib::Request&, httplib::Response& res) {
-        std::vector<uchar> jpg;
-        {
-            std::lock_guard<std::mutex> lk(g_mtx_jpeg);
-            jpg = g_latest_jpeg;
+    // ?after=<frame_id> long-polls until a newer frame exists (304 on timeout);
+    // the id of the frame sent comes back in X-Frame-Id. ?r=thumb|annot as for the stream.
+    svr.Get("/snapshot.jpg", [](const httplib::Request& req, httplib::Response& res) {
+        Rendition rend;
+        if (!parse_rendition(req.get_param_value("r"), rend)) {
+            res.status = 404;
+            res.set_content("unknown rendition\n", "text/plain");
+            return;
         }
-        if (jpg.empty()) {
-            res.status = 503;
-            res.set_content("no frame yet\n", "text/plain");
+        const bool long_poll = req.has_param("after");
+        // without after: a frame newer than the last encode, nothing is encoded between requests
+        uint64_t after = long_poll ? std::strtoull(req.get_param_value("after").c_str(), nullptr, 10)
+                                   : g_jpeg->latest_id(rend);
+
+        JpegFramePtr jpg = g_jpeg->wait_newer(after, long_poll ? kSnapshotPollMs : 500, rend);
+        if (!jpg) {
+            if (long_poll) {
+                res.status = 304;
+            } else {
+                res.status = 503;
+                res.set_content("no frame yet\n", "text/plain");
+            }
             return;
         }
-        res.set_content(reinterpret_cast<const char*>(jpg.data()), jpg.size(), "image/jpeg");
+
         res.set_header("Cache-Control", "no-store");
+        res.set_header("X-Frame-Id", std::to_string(jpg->frame_id));
+        // body streamed from the shared buffer, no copy
+        res.set_content_provider(jpg->jpeg_len, "image/jpeg",
+            [jpg](size_t off, size_t len, httplib::DataSink& sink) {
+                return sink.write(jpg->jpeg() + off, len);
+            });
     });
 
-    // MJPEG stream
-    svr.Get("/stream.mjpg", [](const httplib::Request&, httplib::Response& res) {
-    const std::string boundary = "frame";
-
-    // Header chuẩn MJPEG
-    res.status = 200;
-    res.set_header("Cache-Control", "no-cache, no-store, must-revalidate");
-    res.set_header("Pragma", "no-cache");
-    res.set_header("Expires", "0");
-
-    // Content-Type đúng format
-    const std::string ctype = "multipart/x-mixed-replace; boundary=" + boundary;
-
-    res.set_chunked_content_provider(
-        ctype,
-        [boundary](size_t, httplib::DataSink& sink) {
-            uint64_t last_id = 0;
-
-            while (g_run.load()) {
-                if (!sink.is_writable()) break;
-
-                std::vector<uchar> jpg;
-                uint64_t jpg_id = 0;
+    // Detection push (Server-Sent Events), the same JSON as the UDP messages, so a
+    // browser needs no bridge. Each event is framed once and written to every
+    // subscriber; EventSource reconnects with Last-Event-ID and gets the backlog.
+    svr.Get("/events", [](const httplib::Request& req, httplib::Response& res) {
+        if (!g_events.subscribe()) {
+            res.status = 503;
+            res.set_content("too many event subscribers\n", "text/plain");
+            return;
+        }
+        const uint64_t latest = g_events.latest_id();
+        uint64_t after = latest;
+        if (req.has_header("Last-Event-ID"))
+            after = std::min(latest, (uint64_t)std::strtoull(req.get_header_value("Last-Event-ID").c_str(), nullptr, 10));
 
-                {
-                    std::lock_guard<std::mutex> lk(g_mtx_jpeg);
-                    jpg    = g_latest_jpeg;
-                    jpg_id = g_latest_jpeg_id;
+        res.set_header("Cache-Control", "no-store");
+        res.set_header("Access-Control-Allow-Origin", "*");   // UI page is served from elsewhere
+        res.set_chunked_content_provider(
+            "text/event-stream",
+            [after](size_t, httplib::DataSink& sink) mutable {
+                static const char kRetry[]     = "retry: 1000\n\n";
+                static const char kKeepalive[] = ": keepalive\n\n";
+                uint64_t last_seq = 0;
+
+                if (!sink.write(kRetry, sizeof(kRetry) - 1)) return false;
+                while (g_run.load()) {
+                    if (!sink.is_writable()) break;
+
+                    SseEventPtr e = g_events.next(after, kEventKeepaliveMs);
+                    if (!e) {
+                        // idle (static scene / no subscribers before us) or shutting down
+                        if (g_run.load() && !sink.write(kKeepalive, sizeof(kKeepalive) - 1)) break;
+                        continue;
+                    }
+                    if (last_seq && e->seq > last_seq + 1)
+                        g_events.count_missed(e->seq - last_seq - 1);
+                    last_seq = e->seq;
+                    after    = e->frame_id;
+                    if (!sink.write(e->text.data(), e->text.size())) break;
                 }
+                sink.done();
+                return true;
+            },
+            [](bool) { g_events.unsubscribe(); });
+    });
 
-                if (!jpg.empty() && jpg_id != last_id) {
-                    last_id = jpg_id;
+    // MJPEG stream: served by the epoll server on kStreamPort, keep the old URL working
+    svr.Get("/stream.mjpg", [](const httplib::Request& req, httplib::Response& res) {
+        std::string host = req.get_header_value("Host");
+        // drop the port; an IPv6 literal keeps its brackets ("[::1]:8080" -> "[::1]")
+        size_t end = (!host.empty() && host[0] == '[') ? host.find(']') : host.rfind(':');
+        if (end != std::string::npos)
+            host = host.substr(0, host[0] == '[' ? end + 1 : end);
+        if (host.empty()) host = "localhost";
+        res.set_redirect("http://" + host + ":" + std::to_string(kStreamPort) + req.target);
+    });
 
-                    std::ostringstream ss;
-                    ss << "--" << boundary << "\r\n";
-                    ss << "Content-Type: image/jpeg\r\n";
-                    ss << "Content-Length: " << jpg.size() << "\r\n\r\n";
+    // per-viewer counters of the stream server
+    svr.Get("/streams", [](const httplib::Request&, httplib::Response& res) {
+        std::vector<StreamClientStats> st;
+        g_stream->stats(st);
+        std::ostringstream ss;
+        ss << "viewers " << st.size() << "\n";
+        for (const auto& c : st) {
+            ss << c.peer
+               << " r=" << rendition_name(c.rend)
+               << " age_s=" << std::fixed << std::setprecision(1) << c.age_s
+               << " bytes=" << c.bytes
+               << " frames=" << c.frames
+               << " dropped=" << c.dropped
+               << " lag=" << c.lag << "\n";
+        }
+        res.set_content(ss.str(), "text/plain");
+    });
 
-                    const std::string head = ss.str();
-                    sink.write(head.data(), head.size());
-                    sink.write(reinterpret_cast<const char*>(jpg.data()), jpg.size());
-                    sink.write("\r\n", 2);
-                } else {
-                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                }
-            }
+    // Prometheus scrape: atomics and histogram buckets read relaxed, no pipeline lock
+    svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        const EncodeStats enc = g_jpeg->stats();
+        std::string out;
+        out.reserve(16384);
+        PromWriter w(out);
+        w.counter("yolo_frames_captured_total", "Frames read from the source",
+                  g_cap_cnt.load(std::memory_order_relaxed));
+        w.counter("yolo_frames_dropped_total", "Captured frames overwritten before detection took them",
+                  frames_dropped());
+        w.counter("yolo_frames_static_total", "Frames not inferred because the scene was static",
+                  g_static_cnt.load(std::memory_order_relaxed));
+        w.counter("yolo_frames_detected_total", "Frames through the detect thread",
+                  g_det_cnt.load(std::memory_order_relaxed));
+        w.counter("yolo_inferences_total", "Frames that ran inference",
+                  g_infer_cnt.load(std::memory_order_relaxed));
+        w.counter("yolo_alerts_total", "Audio alerts played", g_audio->played());
+        w.counter("yolo_alerts_ignored_total", "Alert triggers ignored while the sound was playing",
+                  g_audio->ignored());
+        w.counter("yolo_jpeg_encodes_total", "JPEG encodes, all renditions", enc.count);
+        w.counter("yolo_jpeg_bytes_total", "JPEG bytes encoded, all renditions", enc.bytes);
+        const UdpSenderStats udp = g_udp->stats();
+        w.counter("yolo_udp_datagrams_total", "Detection datagrams sent, all subscribers", udp.datagrams);
+        w.counter("yolo_udp_bytes_total", "Detection bytes sent, all subscribers", udp.bytes);
+        w.counter("yolo_udp_eagain_total", "Detection datagrams dropped on a full socket buffer", udp.eagain);
+        w.counter("yolo_udp_errors_total", "Detection datagrams dropped on send errors", udp.errors);
+        w.counter("yolo_events_published_total", "Detection events framed for /events", g_events.published());
+        w.counter("yolo_events_missed_total", "Events a slow /events subscriber skipped", g_events.missed());
+        w.gauge("yolo_event_subscribers", "/events subscribers", g_events.subscribers());
+        w.gauge("yolo_stream_clients", "MJPEG stream viewers", g_stream->clients());
+        w.histogram("yolo_capture_to_detect_seconds", "Frame capture to decode + NMS done, inferred frames only", g_hist_cap_det);
+        w.histogram("yolo_preprocess_seconds", "Resize and tile preprocess", g_hist_pp);
+        w.histogram("yolo_inference_seconds", "ncnn forward", g_hist_infer);
+        w.histogram("yolo_decode_seconds", "Box decode and NMS", g_hist_decode);
+        w.histogram("yolo_udp_send_seconds", "Detection message UDP send", g_hist_udp);
+        w.histogram("yolo_audio_trigger_seconds", "Detection published to alert started", g_hist_audio);
+
+        // stage graph, one series per stage / edge
+        std::vector<StageStats> stages;
+        std::vector<EdgeStats>  edges;
+        g_pipe.stats(stages, edges);
+        std::string name;
+        for (const auto& st : stages) {
+            name = "yolo_stage_" + st.name + "_busy_seconds";
+            w.histogram(name.c_str(), "Stage time per item, waits excluded", *st.busy);
+            name = "yolo_stage_" + st.name + "_busy_ratio";
+            w.gauge(name.c_str(), "Stage busy share since start (busy / (busy + wait))",
+                    st.busy_ns ? (double)st.busy_ns / (double)(st.busy_ns + st.wait_ns) : 0.0);
+        }
+        for (const auto& e : edges) {
+            name = "yolo_edge_" + e.name + "_depth";
+            w.gauge(name.c_str(), "Items waiting on the edge", (double)e.depth);
+            name = "yolo_edge_" + e.name + "_max_depth";
+            w.gauge(name.c_str(), "Most items ever waiting on the edge", (double)e.max_depth);
+            name = "yolo_edge_" + e.name + "_pushed_total";
+            w.counter(name.c_str(), "Items pushed", e.pushed);
+            name = "yolo_edge_" + e.name + "_dropped_total";
+            w.counter(name.c_str(), "Items overwritten or evicted before a consumer took them", e.dropped);
+        }
+        res.set_content(out, "text/plain; version=0.0.4");
+    });
 
-            // kết thúc stream
-            std::string tail = "--" + boundary + "--\r\n";
-            sink.write(tail.data(), tail.size());
-            sink.done();
-            return true;
+    // stage graph at a glance
+    svr.Get("/pipeline", [](const httplib::Request&, httplib::Response& res) {
+        std::vector<StageStats> stages;
+        std::vector<EdgeStats>  edges;
+        g_pipe.stats(stages, edges);
+        std::ostringstream ss;
+        ss << std::fixed << std::setprecision(3);
+        for (const auto& st : stages) {
+            ss << "stage " << st.name
+               << (st.running ? " running" : " ended")
+               << " items=" << st.items
+               << " busy_s=" << st.busy_ns * 1e-9
+               << " wait_s=" << st.wait_ns * 1e-9
+               << " mean_ms=" << (st.items ? st.busy_ns * 1e-6 / st.items : 0.0) << "\n";
+        }
+        for (const auto& e : edges) {
+            ss << "edge " << e.name
+               << " " << edge_policy_name(e.policy)
+               << " cap=" << e.capacity
+               << " depth=" << e.depth
+               << " max=" << e.max_depth
+               << " pushed=" << e.pushed
+               << " popped=" << e.popped
+               << " dropped=" << e.dropped << "\n";
         }
-    );
-});
+        res.set_content(ss.str(), "text/plain");
+    });
 
-    std::cout << "[HTTP] MJPEG server on 0.0.0.0:" << kHttpPort
-              << "  /stream.mjpg  /snapshot.jpg\n";
+    std::cout << "[HTTP] control server on 0.0.0.0:" << kHttpPort
+              << "  /snapshot.jpg  /events  /streams  /metrics  /pipeline  (/stream.mjpg -> :" << kStreamPort << ")\n";
 
     // blocking
     svr.listen("0.0.0.0", kHttpPort);
 }
 
-// THREADS  
-static void camera_thread()
+// STAGES  
+static void camera_stage(StageContext& ctx)
 {
     cv::setNumThreads(1);
 
-    cv::VideoCapture cap(kPipeline, cv::CAP_GSTREAMER);
-    if (!cap.isOpened()) {
-        std::cerr << "[CAM] Failed to open camera pipeline\n";
-        g_run = false;
-        return;
-    }
-
-    cv::Mat frame;
+    cv::Mat spare;   // only used if every pool slot is still held
     uint64_t frame_id = 0;
 
-    std::vector<int> enc_params = { cv::IMWRITE_JPEG_QUALITY, kJpegQuality };
+    while (ctx.running()) {
+        FrameRef slot = g_frame_pool->acquire();
+        cv::Mat& frame = slot ? slot.mat() : spare;
 
-    while (g_run.load()) {
-         
-
-        if (!cap.read(frame) || frame.empty()) {
-            std::cerr << "[CAM] Failed to grab frame\n";
-            g_run = false;
-            break;
+        bool ok;
+        {
+            StageContext::Wait w;   // the source paces the stage
+            ok = g_source->read(frame);
+        }
+        if (!ok) {
+            std::cerr << "[CAM] End of stream or failed to grab frame after " << frame_id << " frames\n";
+            break;   // ends the pipeline
         }
-         
 
         frame_id++;
         g_cap_cnt.fetch_add(1, std::memory_order_relaxed);
+        g_cap_time_ns[frame_id & (kCapTimeRing - 1)].store(
+            std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+
+        // publish latest frame for detector (shares the pool slot, no copy);
+        // an unread one is replaced and counted as dropped by the edge
+        if (slot)
+            g_frames->push(FramePacket{slot, frame_id});
+        else
+            g_drop_cnt.fetch_add(1, std::memory_order_relaxed);
+
+        // JPEG for MJPEG server: hand over the slot, encoded on the encoder thread if anyone watches
+        if (slot)
+            g_jpeg->offer(frame_id, slot);
+        ctx.item();
+    }
 
-        // publish latest frame for detector (clone)
-        {
-            FramePacket pkt;
-            pkt.id = frame_id;
-            pkt.frame = frame.clone();
+    g_source.reset();
+}
+
+// latest frame -> motion gate -> detector pool (round-robin over workers)
+static void dispatch_stage(StageContext& ctx, DetectorPool* pool, MotionConfig motion_cfg,
+                           TileConfig tile_cfg, bool tiled)
+{
+    int skip_counter = 0;
 
-            std::lock_guard<std::mutex> lk(g_mtx_frame);
-            g_latest_frame = std::move(pkt);
-            g_have_frame = true;
+    TilePlanner planner(kFrameW, kFrameH, tile_cfg);
+    std::vector<cv::Rect>  tiles;
+    std::vector<TargetBox> tracked;   // newest boxes from detect_stage
+    const std::vector<TargetBox> no_boxes;
+
+    const bool gate_on = motion_cfg.area_thresh > 0.f;
+    MotionGate motion(motion_cfg);
+    bool was_moving  = true;
+    int  since_infer = 0;
+
+    for (;;) {
+        FramePacket pkt;   // empty, so the mailbox slot it is swapped into holds no frame
+
+        // wait for latest frame
+        if (!g_frames->pop(pkt)) break;   // closed
+        g_tracks->try_pop(tracked);
+
+        bool moving = true;
+        if (gate_on) {
+            moving = motion.update(pkt.frame.mat());
+            if (moving && !was_moving)
+                g_sched.force();   // motion onset: detect on this very frame
+            was_moving = moving;
         }
-        g_cv_frame.notify_one();
 
-        // encode JPEG for MJPEG server
-        std::vector<uchar> jpg;
-        cv::imencode(".jpg", frame, jpg, enc_params);
+        bool run_det;
+        uint32_t flags = 0;
+        if (!moving) {
+            // static scene: reuse the last result, refresh it now and then
+            run_det = since_infer >= kMotionMaxSkip;
+            if (!run_det) {
+                flags = kFrameStatic;
+                g_static_cnt.fetch_add(1, std::memory_order_relaxed);
+            }
+        } else if (kAdaptiveDetect) {
+            run_det = g_sched.should_detect();
+        } else {
+            skip_counter++;
+            run_det = (kDetectEveryN <= 1) ? true : (skip_counter % kDetectEveryN == 0);
+        }
 
+        // crops: zones cut down to where things move or are being tracked
+        tiles.clear();
+        if (run_det && tiled) {
+            cv::Rect focus;
+            if (gate_on && moving)
+                focus = motion.motion_rect();
+            if (!planner.plan(focus, gate_on && moving ? tracked : no_boxes, tiles)) {
+                run_det = false;   // motion outside every zone
+                flags   = kFrameStatic;
+                g_static_cnt.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        since_infer = run_det ? 0 : since_infer + 1;
+
+        bool ok;
         {
-            std::lock_guard<std::mutex> lk(g_mtx_jpeg);
-            g_latest_jpeg = std::move(jpg);
-            g_latest_jpeg_id = frame_id;
+            StageContext::Wait w;   // pool input queue full
+            ok = pool->submit(pkt.id, pkt.frame, run_det, flags, tiles);
         }
- 
+        if (!ok) break;
+        ctx.item();
     }
+}
 
-    cap.release();
+// bbox already in 640x480 frame coordinates
+static void write_detections(DetWriter& w, uint64_t frame_id, double ts, double loop_fps,
+                             double det_fps, bool person, const std::vector<TargetBox>& boxes)
+{
+    w.begin(frame_id, ts, loop_fps, det_fps, person);
+    for (const auto& b : boxes)
+        w.add_box(b.cate, b.score, (float)b.x1, (float)b.y1, (float)b.x2, (float)b.y2);
+    w.finish();
 }
 
-static void detect_thread(yoloFastestv2* detector)
+// detector pool results (in frame order) -> JSON/UDP, /events + logic
+static void detect_stage(StageContext& ctx, DetectorPool* pool, TileConfig tile_cfg,
+                         DetWriter::Format wire_fmt)
 {
-    UdpSender udp("127.0.0.1", 9001);
+    DetWriter wire(wire_fmt);   // one buffer for every message
+    DetWriter sse_json(DetWriter::JSON, wire_fmt == DetWriter::JSON ? 64 : kDetMaxDatagram);   // /events when UDP is binary
 
-    uint64_t last_seen_id = 0;
-    int skip_counter = 0;
+    DetResult res;   // reused across frames
+    MultiTracker tracker;
+    TilePlanner zones(kFrameW, kFrameH, tile_cfg);   // zone filter only
+    std::vector<TargetBox> last_boxes;   // last published result
+    DetPacket det;   // to logic, copied into the mailbox slot (keeps its capacity)
 
     // FPS window
     auto t_fps_last = std::chrono::steady_clock::now();
@@ -281,43 +516,52 @@ static void detect_thread(yoloFastestv2* detector)
     double loop_fps = 0.0;
     double det_fps  = 0.0;
 
-    while (g_run.load()) {
-        FramePacket pkt;
-
-        // wait for latest frame
+    for (;;) {
+        bool ok;
         {
-            std::unique_lock<std::mutex> lk(g_mtx_frame);
-            g_cv_frame.wait(lk, [] { return !g_run.load() || g_have_frame; });
-            if (!g_run.load()) break;
-
-            pkt = g_latest_frame;
-            g_have_frame = false;
+            StageContext::Wait w;
+            ok = pool->next(res);
         }
+        if (!ok) break;
+
+        // tracker: learn from detections, propagate boxes on frames without inference.
+        // Static frames repeat the last result and leave the tracks untouched.
+        if (res.ran_infer) {
+            zones.filter(res.boxes);   // crops reach past the zones
+            tracker.update(res.frame_id, res.boxes);
+        } else if (res.flags & kFrameStatic) {
+            res.boxes.assign(last_boxes.begin(), last_boxes.end());
+        } else {
+            tracker.predict(res.frame_id, res.boxes);
+        }
+        last_boxes.assign(res.boxes.begin(), res.boxes.end());   // keeps capacity
+        if (kAdaptiveDetect)
+            g_sched.set_interval(tracker.suggest_interval(1, kDetectMaxEvery));
 
-        if (pkt.id == last_seen_id) continue;
-        last_seen_id = pkt.id;
-
-        // PERF begin per-frame  
-        PERF_FRAME_BEGIN((int)pkt.id);
-        PERF_MARK_CAM(); // "frame arrived to detect thread"
-
-        skip_counter++;
-        bool run_det = (kDetectEveryN <= 1) ? true : (skip_counter % kDetectEveryN == 0);
-        PERF_SET_RAN_INFER(run_det);
-
-        std::vector<TargetBox> boxes;
+        const std::vector<TargetBox>& boxes = res.boxes;
 
-        // preprocess -> 352x352 for YOLO
-        cv::Mat yolo_in;
-        cv::resize(pkt.frame, yolo_in, cv::Size(352, 352));
-        PERF_MARK_PP();
+        // annotated rendition: this frame with its own final boxes
+        if (res.frame) {
+            g_jpeg->offer_annotated(res.frame_id, res.frame, boxes);
+            res.frame.reset();
+        }
 
-        if (run_det) {
-            PERF_MARK_DET_S();
-            detector->detection(yolo_in, boxes, kDetThresh);
-            PERF_MARK_DET_E();
+        // PERF per-frame: cam = handed to detector, det_e = decode + NMS done
+        PERF_FRAME_BEGIN((int)res.frame_id);
+        PERF_SET_RAN_INFER(res.ran_infer);
+        PERF_SET_DET_TIMES(to_sec(res.t_submit), to_sec(res.t_pp),
+                           res.ran_infer ? to_sec(res.t_det_s) : 0.0,
+                           res.ran_infer ? to_sec(res.t_det_e) : 0.0);
 
+        if (res.ran_infer) {
             det_cnt_window++;
+            g_infer_cnt.fetch_add(1, std::memory_order_relaxed);
+            g_hist_pp.record(res.t_pp - res.t_pp_s);
+            g_hist_infer.record(res.t_infer_e - res.t_det_s);
+            g_hist_decode.record(res.t_det_e - res.t_infer_e);
+            // inferred frames only: skipped/static ones have t_det_e = t_submit
+            const int64_t t_cap = g_cap_time_ns[res.frame_id & (kCapTimeRing - 1)].load(std::memory_order_relaxed);
+            g_hist_cap_det.record(res.t_det_e.time_since_epoch() - std::chrono::steady_clock::duration(t_cap));
         }
 
         // FPS update every ~1s
@@ -350,67 +594,42 @@ static void detect_thread(yoloFastestv2* detector)
         double ts = (double)std::chrono::duration_cast<std::chrono::milliseconds>(
                         std::chrono::system_clock::now().time_since_epoch()).count() / 1000.0;
 
-        // build JSON
-        std::ostringstream ss;
-        ss << "{";
-        ss << "\"ts\":" << std::fixed << std::setprecision(3) << ts;
-        ss << ",\"frame_id\":" << pkt.id;
-        ss << ",\"loop_fps\":" << std::fixed << std::setprecision(2) << loop_fps;
-        ss << ",\"det_fps\":"  << std::fixed << std::setprecision(2) << det_fps;
-        ss << ",\"person\":" << (person ? "true" : "false");
-        ss << ",\"detections\":[";
-
-        for (size_t i=0; i<boxes.size(); i++) {
-            const auto& b = boxes[i];
-
-            // bbox from 352-space -> scale back to 640x480
-            float x1 = b.x1 * SCALE_X;
-            float y1 = b.y1 * SCALE_Y;
-            float x2 = b.x2 * SCALE_X;
-            float y2 = b.y2 * SCALE_Y;
-
-            ss << "{"
-               << "\"cls\":\"" << (b.cate==0 ? "person" : "other") << "\""
-               << ",\"conf\":" << std::fixed << std::setprecision(3) << b.score
-               << ",\"bbox\":[" << x1 << "," << y1 << "," << x2 << "," << y2 << "]"
-               << "}";
-            if (i+1<boxes.size()) ss << ",";
-        }
-        ss << "]}";
-        
-        bool will_beep = false;
-        for (const auto& b : boxes) {
-            if (b.cate == 0 && b.score >= kPersonConf) { will_beep = true; break; }
+        // JSON (or binary) message, into the writer's buffer
+        write_detections(wire, res.frame_id, ts, loop_fps, det_fps, person, boxes);
+
+        // browser push first, it is what the alert UI waits on; always JSON
+        if (g_events.has_subscribers()) {
+            if (wire.format() == DetWriter::JSON) {
+                g_events.publish(res.frame_id, wire.data(), wire.size());
+            } else {
+                write_detections(sse_json, res.frame_id, ts, loop_fps, det_fps, person, boxes);
+                g_events.publish(res.frame_id, sse_json.data(), sse_json.size());
+            }
         }
-        if (will_beep) PERF_MARK_AUD();
 
-        udp.send_str(ss.str());
+        const auto t_send = std::chrono::steady_clock::now();
+        g_udp->send(wire.data(), wire.size());   // every subscriber, one sendmmsg
+        g_hist_udp.record(std::chrono::steady_clock::now() - t_send);
         PERF_MARK_DEC();        // after "decision/send"
         PERF_FRAME_COMMIT();    // commit per frame
 
         g_det_cnt.fetch_add(1, std::memory_order_relaxed);
 
-        // publish for logic/audio (optional)
-        {
-            DetPacket det;
-            det.frame_id = pkt.id;
-            det.boxes = boxes;
-            det.t_done = std::chrono::steady_clock::now();
-
-            std::lock_guard<std::mutex> lk(g_mtx_det);
-            g_latest_det = std::move(det);
-            g_have_det = true;
-        }
-        g_cv_det.notify_one();
+        // publish for logic/audio, and the boxes for dispatch's tiles
+        det.frame_id = res.frame_id;
+        det.boxes.assign(boxes.begin(), boxes.end());   // keeps capacity
+        det.t_done = std::chrono::steady_clock::now();
+        g_dets->push(det);
+        g_tracks->push(boxes);
+        ctx.item();
     }
 }
 
-static void logic_thread()
+static void logic_stage(StageContext& ctx)
 {
-    AudioPlayer player("/home/pi/person_detected.wav", 2000);
-
     DetPacket last_det;
     bool have_last = false;
+    bool fresh = false;   // last_det arrived in this round
 
     auto t_start = std::chrono::steady_clock::now();
     auto t_log0  = t_start;
@@ -418,29 +637,25 @@ static void logic_thread()
     uint64_t cap_prev = 0;
     uint64_t det_prev = 0;
 
-    while (g_run.load()) {
+    while (ctx.running()) {
         // wait detection (timeout to allow log)
-        {
-            std::unique_lock<std::mutex> lk(g_mtx_det);
-            g_cv_det.wait_for(lk, std::chrono::milliseconds(200), [] {
-                return !g_run.load() || g_have_det;
-            });
-            if (!g_run.load()) break;
-
-            if (g_have_det) {
-                last_det = g_latest_det;
-                g_have_det = false;
-                have_last = true;
-            }
-        }
+        fresh = g_dets->pop(last_det, 200);
+        if (!ctx.running()) break;
+        if (fresh)
+            have_last = true;
 
         if (have_last) {
             bool person_found = false;
             for (const auto& b : last_det.boxes) {
                 if (b.cate == 0 && b.score >= kPersonConf) { person_found = true; break; }
             }
-            if (person_found) player.play();
+            // t_aud + trigger latency are stamped by the audio thread when the sound starts
+            if (person_found)
+                g_audio->play(last_det.frame_id, fresh ? last_det.t_done
+                                                       : std::chrono::steady_clock::now());
         }
+        if (fresh)
+            ctx.item();
 
         // log fps
         auto now = std::chrono::steady_clock::now();
@@ -457,12 +672,19 @@ static void logic_thread()
             cap_prev = cap_now;
             det_prev = det_now;
 
+            const EncodeStats enc = g_jpeg->stats();
+
             std::cout
                 << "[t=" << sec_since(t_start) << "s] "
                 << "LoopFPS=" << loop_fps
                 << "  DetFPS="  << det_fps
                 << "  total_loop=" << cap_now
                 << "  total_det="  << det_now
+                << "  dropped="    << frames_dropped()
+                << "  static="     << g_static_cnt.load(std::memory_order_relaxed)
+                << "  viewers="    << g_stream->clients()
+                << "  jpeg="       << enc.count
+                << " (p50=" << enc.quantile_ms(0.5) << "ms p95=" << enc.quantile_ms(0.95) << "ms)"
                 << "\n";
 
             t_log0 = now;
@@ -471,46 +693,179 @@ static void logic_thread()
 }
 
 // main
-int main()
+int main(int argc, char** argv)
 {
+    int det_workers = kDetWorkers;
+    int det_threads = kDetThreads;
+    MotionConfig motion_cfg;
+    motion_cfg.pixel_thresh = kMotionPixel;
+    motion_cfg.area_thresh  = kMotionArea;
+    TileConfig tile_cfg;
+    bool tiled = kTiledDetect;
+    DetWriter::Format wire_fmt = DetWriter::JSON;
+    std::vector<std::string> udp_dests;
+    AudioConfig audio_cfg;
+    audio_cfg.throttle_ms = kAlertThrottleMs;
+    std::string model_param = kModelParam;
+    std::string model_bin   = kModelBin;
+    std::string alert_wav   = kAlertWav;
+    SourceConfig src_cfg;
+    src_cfg.path   = kPipeline;
+    src_cfg.width  = kFrameW;
+    src_cfg.height = kFrameH;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string key = argv[i];
+        if (key == "--workers")      det_workers = std::max(1, std::atoi(argv[i + 1]));
+        else if (key == "--threads") det_threads = std::max(1, std::atoi(argv[i + 1]));
+        else if (key == "--motion-pixel") motion_cfg.pixel_thresh = std::atoi(argv[i + 1]);
+        else if (key == "--motion-area")  motion_cfg.area_thresh  = (float)std::atof(argv[i + 1]);
+        else if (key == "--tiles")        tiled = std::atoi(argv[i + 1]) != 0;
+        else if (key == "--zone") {
+            cv::Rect z;
+            if (std::sscanf(argv[i + 1], "%d,%d,%d,%d", &z.x, &z.y, &z.width, &z.height) == 4)
+                tile_cfg.zones.push_back(z);
+            else
+                std::cerr << "[WARN] --zone expects x,y,w,h\n";
+        }
+        else if (key == "--source") {
+            if (!parse_source(argv[i + 1], src_cfg))
+                std::cerr << "[WARN] --source expects camera, gst:<pipeline>, file:<path>, dir:<path>, synth[:seed] or replay:<path>\n";
+        }
+        else if (key == "--fps")    src_cfg.fps    = std::atof(argv[i + 1]);
+        else if (key == "--loop")   src_cfg.loop   = std::atoi(argv[i + 1]) != 0;
+        else if (key == "--frames") src_cfg.frames = std::atoll(argv[i + 1]);
+        else if (key == "--udp")    udp_dests.push_back(argv[i + 1]);
+        else if (key == "--model") {
+            if (i + 2 < argc) {
+                model_param = argv[i + 1];
+                model_bin   = argv[i + 2];
+                i++;
+            } else
+                std::cerr << "[WARN] --model expects <param> <bin>\n";
+        }
+        else if (key == "--wav")    alert_wav = argv[i + 1];
+        else if (key == "--audio") {
+            if (!parse_audio_sink(argv[i + 1], audio_cfg))
+                std::cerr << "[WARN] --audio expects alsa[:<pcm>], file:<out.wav> or null\n";
+        }
+        else if (key == "--audio-overlap") {
+            std::string o = argv[i + 1];
+            if (o == "ignore")       audio_cfg.overlap = AudioConfig::OVERLAP_IGNORE;
+            else if (o == "restart") audio_cfg.overlap = AudioConfig::OVERLAP_RESTART;
+            else if (o == "mix")     audio_cfg.overlap = AudioConfig::OVERLAP_MIX;
+            else std::cerr << "[WARN] --audio-overlap expects ignore, restart or mix\n";
+        }
+        else if (key == "--udp-format") {
+            std::string f = argv[i + 1];
+            if (f == "json")        wire_fmt = DetWriter::JSON;
+            else if (f == "binary") wire_fmt = DetWriter::BINARY;
+            else std::cerr << "[WARN] --udp-format expects json or binary\n";
+        }
+        else std::cerr << "[WARN] unknown option " << key << "\n";
+    }
+
+    g_source = open_frame_source(src_cfg);
+    if (!g_source) {
+        std::cerr << "[CAM] Failed to open frame source\n";
+        return -1;
+    }
+
+    if (udp_dests.empty())
+        udp_dests.push_back(kUdpDest);
+    g_udp.reset(new UdpSender());
+    for (const std::string& d : udp_dests)
+        if (!g_udp->add_destination(d))
+            std::cerr << "[WARN] --udp expects host:port, ignoring " << d << "\n";
+    if (!g_udp->open(kUdpSndBuf, kUdpMcastTtl))
+        return -1;
+
+    g_audio.reset(new AudioPlayer(alert_wav, audio_cfg));
+    g_audio->set_listener([](uint64_t frame_id, AudioPlayer::clock::time_point t_ref,
+                             AudioPlayer::clock::time_point t_start) {
+        g_hist_audio.record(t_start - t_ref);
+        PERF_MARK_AUD_AT((int64_t)frame_id, to_sec(t_start));
+    });
+    if (!g_audio->start())
+        std::cerr << "[AUDIO] alert sound unavailable, alerts are silent\n";
+
+    DetectorPool detectors(det_workers, det_threads);
+
+    // capture slot + frames mailbox (latest + one overwritten) + frames in the detector pipelines
+    // + result being handed out + encoder (pending + annotated + encoding) + 1 spare
+    g_frame_pool.reset(new FramePool(8 + detectors.max_in_flight(), kFrameW, kFrameH));
+    g_jpeg.reset(new JpegEncoder(kJpegQuality, kMjpegBoundary));
+    g_stream.reset(new MjpegServer(*g_jpeg, kMjpegBoundary, kStreamQueue));   // sets the encoder listener
+    g_jpeg->start();
+    if (g_stream->start(kStreamPort) == 0)
+        std::cout << "[HTTP] MJPEG stream server on 0.0.0.0:" << kStreamPort << "  /stream.mjpg\n";
+
     if (kUseVulkan) ncnn::create_gpu_instance();
 
     // PERF
-    PERF_INIT("perf_log.csv");
+    PERF_INIT("perf_log.bin");   // perf2csv perf_log.bin perf_log.csv
 
-    yoloFastestv2 detector;
-    detector.init(kUseVulkan);
+    // early exit: the stream server, encoder and audio threads are already running
+    auto stop_services = [] {
+        g_stream->stop();
+        g_jpeg->stop();
+        g_audio->stop();
+        if (kUseVulkan) ncnn::destroy_gpu_instance();
+        PERF_SHUTDOWN();
+    };
 
-    if (detector.loadModel("/home/pi/models/yolo-fastestv2-opt.param",
-                           "/home/pi/models/yolo-fastestv2-opt.bin") != 0)
+    if (detectors.load(model_param.c_str(), model_bin.c_str(), kUseVulkan) != 0)
     {
         std::cerr << "Failed to load YOLOFastestV2 model\n";
-        if (kUseVulkan) ncnn::destroy_gpu_instance();
+        stop_services();
         return -1;
     }
 
     std::cout << "[INFO] Start. Vulkan=" << (kUseVulkan ? "ON":"OFF")
-              << " detect_every=" << kDetectEveryN
+              << " detect_every=" << (kAdaptiveDetect ? std::string("adaptive")
+                                                      : std::to_string(kDetectEveryN))
+              << " workers=" << det_workers << "x" << det_threads << "thr"
+              << " motion_gate=" << (motion_cfg.area_thresh > 0.f ? "ON" : "OFF")
+              << " tiles=" << (tiled ? "ON" : "OFF")
+              << " zones=" << tile_cfg.zones.size()
+              << " source=" << g_source->describe()
+              << " udp=" << g_udp->describe() << (wire_fmt == DetWriter::BINARY ? " (binary)" : " (json)")
+              << " audio=" << g_audio->describe()
               << " headless=ON\n";
 
-    std::thread th_http(http_server_thread);
-    std::thread th_cam(camera_thread);
-    std::thread th_det(detect_thread, &detector);
-    std::thread th_log(logic_thread);
+    g_frames = g_pipe.add_edge<FramePacket>("frames", EDGE_KEEP_LATEST);
+    g_dets   = g_pipe.add_edge<DetPacket>("detections", EDGE_KEEP_LATEST);
+    g_tracks = g_pipe.add_edge<std::vector<TargetBox>>("tracks", EDGE_KEEP_LATEST);
+    g_pipe.add_stage("camera", camera_stage);
+    g_pipe.add_stage("dispatch", [&](StageContext& c) { dispatch_stage(c, &detectors, motion_cfg, tile_cfg, tiled); });
+    g_pipe.add_stage("detect", [&](StageContext& c) { detect_stage(c, &detectors, tile_cfg, wire_fmt); });
+    g_pipe.add_stage("logic", logic_stage);
+
+    detectors.set_detection(kDetThresh, kDetClasses);
+    if (detectors.start() != 0) {
+        std::cerr << "Failed to start detector pipelines\n";
+        stop_services();
+        return -1;
+    }
+    std::thread th_http(http_server_thread);   // after the last early exit, it is never joined
+    g_pipe.start();
 
     // nếu cam chết -> stop all
-    th_cam.join();
+    g_pipe.wait();
     g_run = false;
-    g_cv_frame.notify_all();
-    g_cv_det.notify_all();
+    g_pipe.request_stop();   // closes the edges: dispatch and logic wake up and return
+    g_events.stop();
+    detectors.stop();        // detect_stage's next() returns false
+    g_stream->stop();
+    g_jpeg->stop();
 
-    th_det.join();
-    th_log.join();
+    g_pipe.join();
+    g_audio->stop();
 
     // http listen blocking -> detach là ok demo
     th_http.detach();
 
     if (kUseVulkan) ncnn::destroy_gpu_instance();
+    PERF_SHUTDOWN();
     std::cout << "[INFO] Exit.\n";
     return 0;
 }
\ No newline at end of file
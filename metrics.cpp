@@ -0,0 +1,85 @@
+#include "metrics.hpp"
+
+#include <cstdio>
+
+//  LatencyHistogram
+uint64_t LatencyHistogram::count() const
+{
+    uint64_t n = 0;
+    for (int i = 0; i < kBuckets; i++)
+        n += bucket(i);
+    return n;
+}
+
+uint64_t LatencyHistogram::upper_us(int i)
+{
+    if (i < kSub)
+        return (uint64_t)i + 1;
+    int msb = i / kSub + kSubBits - 1;
+    int sub = i % kSub;
+    return (uint64_t)(kSub + sub + 1) << (msb - kSubBits);
+}
+
+//  PromWriter
+void PromWriter::header(const char* name, const char* help, const char* type)
+{
+    out_ += "# HELP ";
+    out_ += name;
+    out_ += ' ';
+    out_ += help;
+    out_ += "\n# TYPE ";
+    out_ += name;
+    out_ += ' ';
+    out_ += type;
+    out_ += '\n';
+}
+
+void PromWriter::counter(const char* name, const char* help, uint64_t value)
+{
+    char line[160];
+    header(name, help, "counter");
+    std::snprintf(line, sizeof(line), "%s %llu\n", name, (unsigned long long)value);
+    out_ += line;
+}
+
+void PromWriter::gauge(const char* name, const char* help, double value)
+{
+    char line[160];
+    header(name, help, "gauge");
+    std::snprintf(line, sizeof(line), "%s %.6g\n", name, value);
+    out_ += line;
+}
+
+void PromWriter::histogram(const char* name, const char* help, const LatencyHistogram& h)
+{
+    static const int kFirstOctave = 6;    // 64 us
+    static const int kLastOctave  = 25;   // 33.5 s
+
+    // one pass over the buckets; the exported edges are bucket edges, so
+    // the cumulative counts are exact
+    uint64_t counts[LatencyHistogram::kBuckets];
+    uint64_t total = 0;
+    for (int i = 0; i < LatencyHistogram::kBuckets; i++) {
+        counts[i] = h.bucket(i);
+        total += counts[i];
+    }
+
+    header(name, help, "histogram");
+    char line[200];
+    uint64_t cum = 0;
+    int      b   = 0;
+    for (int oct = kFirstOctave; oct <= kLastOctave; oct++) {
+        const uint64_t edges[2] = { 1ull << oct, (3ull << oct) / 2 };
+        for (int e = 0; e < 2; e++) {
+            while (b < LatencyHistogram::kBuckets && LatencyHistogram::upper_us(b) <= edges[e])
+                cum += counts[b++];
+            std::snprintf(line, sizeof(line), "%s_bucket{le=\"%.6g\"} %llu\n",
+                          name, edges[e] * 1e-6, (unsigned long long)cum);
+            out_ += line;
+        }
+    }
+    std::snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %llu\n%s_sum %.6f\n%s_count %llu\n",
+                  name, (unsigned long long)total, name, h.sum_ns() * 1e-9,
+                  name, (unsigned long long)total);
+    out_ += line;
+}
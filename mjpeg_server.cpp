@@ -0,0 +1,461 @@
+#include "mjpeg_server.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const size_t kMaxRequest = 4096;
+
+struct MjpegServer::Client
+{
+    int         fd = -1;
+    std::string peer;
+    std::chrono::steady_clock::time_point t_open;
+
+    Rendition   rend      = REND_FULL;
+    bool        streaming = false;   // request accepted, header queued
+    bool        closing   = false;   // close once out is sent
+    bool        out_armed = false;   // EPOLLOUT registered
+    std::string req;
+
+    // pending bytes: a response header first (out_str), then frames
+    std::string  out_str;
+    size_t       out_off = 0;
+    JpegFramePtr cur;
+    size_t       cur_off = 0;
+
+    // bounded ring of frames waiting behind cur
+    std::vector<JpegFramePtr> q;
+    size_t q_head  = 0;
+    size_t q_count = 0;
+
+    uint64_t bytes   = 0;
+    uint64_t frames  = 0;
+    uint64_t dropped = 0;
+};
+
+//  MjpegServer
+MjpegServer::MjpegServer(JpegEncoder& encoder, const std::string& boundary,
+                         int queue_len, int max_clients)
+    : enc_(encoder)
+    , boundary_(boundary)
+    , queue_len_(queue_len < 1 ? 1 : queue_len)
+    , max_clients_(max_clients)
+{
+    stream_head_ =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: multipart/x-mixed-replace; boundary=" + boundary_ + "\r\n"
+        "Cache-Control: no-cache, no-store, must-revalidate\r\n"
+        "Pragma: no-cache\r\n"
+        "Expires: 0\r\n"
+        "Connection: close\r\n\r\n";
+
+    enc_.set_listener([this](Rendition r, const JpegFramePtr& f) { on_frame(r, f); });
+}
+
+MjpegServer::~MjpegServer()
+{
+    stop();
+}
+
+int MjpegServer::start(int port)
+{
+    if (running_.load())
+        return -1;
+
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        std::perror("socket");
+        return -1;
+    }
+    int one = 1;
+    ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (::bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, 128) != 0) {
+        std::perror("bind/listen");
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return -1;
+    }
+
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_  = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+        std::perror("epoll/eventfd");
+        stop();
+        return -1;
+    }
+
+    epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = listen_fd_;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+    ev.data.fd = wake_fd_;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+
+    running_ = true;
+    loop_thread_ = std::thread(&MjpegServer::loop, this);
+    return 0;
+}
+
+void MjpegServer::stop()
+{
+    {
+        // the encoder may still call on_frame(): it checks running_ under feed_mtx_
+        std::lock_guard<std::mutex> lk(feed_mtx_);
+        running_ = false;
+        if (wake_fd_ >= 0) {
+            uint64_t one = 1;
+            ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+            (void)n;
+        }
+    }
+    if (loop_thread_.joinable()) loop_thread_.join();
+
+    while (!clients_.empty())
+        close_client(clients_.begin()->first);
+    if (listen_fd_ >= 0) { ::close(listen_fd_); listen_fd_ = -1; }
+    if (epoll_fd_ >= 0)  { ::close(epoll_fd_);  epoll_fd_  = -1; }
+    std::lock_guard<std::mutex> lk(feed_mtx_);
+    if (wake_fd_ >= 0)   { ::close(wake_fd_);   wake_fd_   = -1; }
+    for (int r = 0; r < REND_COUNT; r++)
+        incoming_[r].reset();
+}
+
+void MjpegServer::stats(std::vector<StreamClientStats>& out) const
+{
+    std::lock_guard<std::mutex> lk(stats_mtx_);
+    out = stats_;
+}
+
+//  encoder -> event loop
+// Runs on the encoder thread: only hands the frame over, the event loop
+// does the rest. A frame not yet picked up is replaced by the newer one.
+void MjpegServer::on_frame(Rendition r, const JpegFramePtr& f)
+{
+    std::lock_guard<std::mutex> lk(feed_mtx_);
+    if (!running_.load() || wake_fd_ < 0)
+        return;
+    incoming_[r] = f;
+    uint64_t one = 1;
+    ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    (void)n;
+}
+
+// Non-blocking: the encoder makes one more JPEG of each rendition some
+// client is idle for, and drops the demand once it has.
+void MjpegServer::request_frames()
+{
+    for (int r = 0; r < REND_COUNT; r++) {
+        if (!want_frame_[r])
+            continue;
+        want_frame_[r] = false;
+        enc_.request((Rendition)r);
+    }
+}
+
+//  event loop
+void MjpegServer::loop()
+{
+    epoll_event events[64];
+    auto t_stats = std::chrono::steady_clock::now();
+
+    while (running_.load()) {
+        int n = ::epoll_wait(epoll_fd_, events, 64, 1000);
+        if (n < 0 && errno != EINTR) {
+            std::perror("epoll_wait");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            const int fd = events[i].data.fd;
+            const uint32_t ev = events[i].events;
+
+            if (fd == listen_fd_) {
+                accept_clients();
+                continue;
+            }
+            if (fd == wake_fd_) {
+                uint64_t cnt;
+                ssize_t r = ::read(wake_fd_, &cnt, sizeof(cnt));
+                (void)r;
+                JpegFramePtr f[REND_COUNT];
+                {
+                    std::lock_guard<std::mutex> lk(feed_mtx_);
+                    for (int r = 0; r < REND_COUNT; r++)
+                        f[r].swap(incoming_[r]);
+                }
+                for (int r = 0; r < REND_COUNT; r++) {
+                    if (f[r])
+                        deliver((Rendition)r, f[r]);
+                }
+                continue;
+            }
+
+            auto it = clients_.find(fd);
+            if (it == clients_.end())
+                continue;
+            Client& c = *it->second;
+
+            if (ev & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                close_client(fd);
+                continue;
+            }
+            if (ev & EPOLLIN) {
+                on_readable(c);
+                if (clients_.find(fd) == clients_.end())
+                    continue;
+            }
+            if (ev & EPOLLOUT)
+                flush(c);
+        }
+
+        request_frames();
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - t_stats >= std::chrono::seconds(1)) {
+            publish_stats();
+            t_stats = now;
+        }
+    }
+}
+
+void MjpegServer::accept_clients()
+{
+    for (;;) {
+        sockaddr_in addr;
+        socklen_t   len = sizeof(addr);
+        int fd = ::accept4(listen_fd_, (sockaddr*)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;   // EAGAIN: accepted everything pending
+
+        if ((int)clients_.size() >= max_clients_) {
+            ::close(fd);
+            continue;
+        }
+
+        std::unique_ptr<Client> c(new Client());
+        char ip[INET_ADDRSTRLEN] = "?";
+        ::inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        c->fd     = fd;
+        c->peer   = std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+        c->t_open = std::chrono::steady_clock::now();
+        c->q.resize(queue_len_);
+
+        epoll_event ev;
+        ev.events  = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ::close(fd);
+            continue;
+        }
+        clients_[fd] = std::move(c);
+    }
+}
+
+// Reads the request line; streaming clients aren't expected to send more.
+void MjpegServer::on_readable(Client& c)
+{
+    char buf[1024];
+    for (;;) {
+        ssize_t n = ::recv(c.fd, buf, sizeof(buf), 0);
+        if (n == 0) {
+            close_client(c.fd);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            close_client(c.fd);
+            return;
+        }
+        if (!c.streaming && !c.closing)
+            c.req.append(buf, (size_t)n);
+    }
+    if (c.streaming || c.closing)
+        return;
+
+    if (c.req.find("\r\n\r\n") == std::string::npos) {
+        if (c.req.size() > kMaxRequest)
+            close_client(c.fd);
+        return;
+    }
+
+    // "GET /stream.mjpg[?...r=name...] HTTP/1.x"
+    bool ok = c.req.compare(0, 17, "GET /stream.mjpg ") == 0 ||
+              c.req.compare(0, 17, "GET /stream.mjpg?") == 0;
+    if (ok && c.req[16] == '?') {
+        const size_t end = c.req.find(' ', 17);
+        const std::string query = c.req.substr(17, end == std::string::npos ? 0 : end - 17);
+        std::string name;
+        for (size_t pos = 0; pos < query.size(); ) {
+            size_t amp = query.find('&', pos);
+            if (amp == std::string::npos)
+                amp = query.size();
+            if (query.compare(pos, 2, "r=") == 0)
+                name = query.substr(pos + 2, amp - pos - 2);
+            pos = amp + 1;
+        }
+        ok = parse_rendition(name, c.rend);
+    }
+    c.req.clear();
+    c.req.shrink_to_fit();
+
+    if (!ok) {
+        c.out_str = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        c.closing = true;
+        flush(c);
+        return;
+    }
+
+    c.out_str   = stream_head_;
+    c.streaming = true;
+    num_streaming_.fetch_add(1, std::memory_order_relaxed);
+
+    // start with the newest JPEG there is, then live frames
+    c.cur = enc_.latest(c.rend);
+    flush(c);
+}
+
+// New frame for every client of its rendition: drop-to-latest when the
+// queue is full.
+void MjpegServer::deliver(Rendition r, const JpegFramePtr& f)
+{
+    latest_id_[r] = f->frame_id;
+
+    for (auto it = clients_.begin(); it != clients_.end(); ) {
+        Client& c = *it->second;
+        ++it;   // flush() may close (erase) c
+        if (!c.streaming || c.rend != r)
+            continue;
+
+        if (c.q_count == c.q.size()) {
+            c.q[c.q_head].reset();
+            c.q_head = (c.q_head + 1) % c.q.size();
+            c.q_count--;
+            c.dropped++;
+        }
+        c.q[(c.q_head + c.q_count) % c.q.size()] = f;
+        c.q_count++;
+
+        if (!c.out_armed)
+            flush(c);
+    }
+}
+
+// Writes as much as the socket takes. Returns false if the client was closed.
+bool MjpegServer::flush(Client& c)
+{
+    for (;;) {
+        const char* p;
+        size_t      len;
+        if (c.out_off < c.out_str.size()) {
+            p   = c.out_str.data() + c.out_off;
+            len = c.out_str.size() - c.out_off;
+        } else {
+            if (!c.cur && c.q_count > 0) {
+                c.cur.swap(c.q[c.q_head]);
+                c.q_head = (c.q_head + 1) % c.q.size();
+                c.q_count--;
+                c.cur_off = 0;
+            }
+            if (!c.cur)
+                break;
+            p   = c.cur->part.data() + c.cur_off;
+            len = c.cur->part.size() - c.cur_off;
+        }
+
+        ssize_t n = ::send(c.fd, p, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                set_out(c, true);
+                return true;
+            }
+            close_client(c.fd);
+            return false;
+        }
+        c.bytes += (uint64_t)n;
+
+        if (c.out_off < c.out_str.size()) {
+            c.out_off += (size_t)n;
+        } else {
+            c.cur_off += (size_t)n;
+            if (c.cur_off == c.cur->part.size()) {
+                c.cur.reset();
+                c.frames++;
+            }
+        }
+    }
+
+    // everything sent
+    set_out(c, false);
+    if (c.closing) {
+        close_client(c.fd);
+        return false;
+    }
+    if (c.streaming)
+        want_frame_[c.rend] = true;   // drained: ask for the next one
+    return true;
+}
+
+void MjpegServer::set_out(Client& c, bool on)
+{
+    if (c.out_armed == on)
+        return;
+    epoll_event ev;
+    ev.events  = EPOLLIN | EPOLLRDHUP | (on ? EPOLLOUT : 0u);
+    ev.data.fd = c.fd;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev);
+    c.out_armed = on;
+}
+
+void MjpegServer::close_client(int fd)
+{
+    auto it = clients_.find(fd);
+    if (it == clients_.end())
+        return;
+    if (it->second->streaming)
+        num_streaming_.fetch_sub(1, std::memory_order_relaxed);
+    if (epoll_fd_ >= 0)
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    clients_.erase(it);
+}
+
+void MjpegServer::publish_stats()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lk(stats_mtx_);
+    stats_.clear();
+    for (auto& kv : clients_) {
+        const Client& c = *kv.second;
+        if (!c.streaming)
+            continue;
+        StreamClientStats s;
+        s.fd      = c.fd;
+        s.peer    = c.peer;
+        s.rend    = c.rend;
+        s.bytes   = c.bytes;
+        s.frames  = c.frames;
+        s.dropped = c.dropped;
+        // behind by the frame still being sent, if any
+        const uint64_t newest = latest_id_[c.rend];
+        s.lag     = (c.cur && newest > c.cur->frame_id) ? newest - c.cur->frame_id : 0;
+        s.age_s   = std::chrono::duration<double>(now - c.t_open).count();
+        stats_.push_back(s);
+    }
+}
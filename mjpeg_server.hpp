@@ -0,0 +1,98 @@
+#ifndef MJPEG_SERVER_HPP
+#define MJPEG_SERVER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "jpeg_encoder.hpp"
+
+struct StreamClientStats
+{
+    int         fd = -1;
+    std::string peer;
+    Rendition   rend    = REND_FULL;
+    uint64_t    bytes   = 0;   // sent, headers included
+    uint64_t    frames  = 0;   // fully sent
+    uint64_t    dropped = 0;   // replaced in the queue before being sent
+    uint64_t    lag     = 0;   // camera frames the frame being sent is behind the newest JPEG
+    double      age_s   = 0.0;
+};
+
+// epoll-based /stream.mjpg server, beside httplib (which keeps the control
+// endpoints). One event-loop thread does every socket operation with
+// non-blocking writes; JPEGs arrive through the encoder's listener.
+// /stream.mjpg?r=thumb|annot selects a rendition, each client only gets
+// frames of its own.
+//
+// Each client has a bounded queue of frames to send. When a new frame
+// arrives and the queue is full the oldest queued frame is dropped, so a
+// slow client skips frames and stays close to live instead of building
+// up lag, and never holds up the others. A new frame is requested from the
+// encoder only once some client has drained its queue, so encoding of a
+// rendition follows its fastest viewer and stops when it has none.
+class MjpegServer
+{
+public:
+    MjpegServer(JpegEncoder& encoder, const std::string& boundary,
+                int queue_len = 2, int max_clients = 256);
+    ~MjpegServer();
+
+    MjpegServer(const MjpegServer&) = delete;
+    MjpegServer& operator=(const MjpegServer&) = delete;
+
+    int  start(int port);   // 0 ok, -1 socket setup failed
+    void stop();
+
+    int  clients() const { return num_streaming_.load(std::memory_order_relaxed); }
+    // per-client counters, refreshed by the event loop about once a second
+    void stats(std::vector<StreamClientStats>& out) const;
+
+private:
+    struct Client;
+
+    void loop();
+    void on_frame(Rendition r, const JpegFramePtr& f);   // encoder thread
+
+    void accept_clients();
+    void on_readable(Client& c);
+    void deliver(Rendition r, const JpegFramePtr& f);
+    bool flush(Client& c);   // false: client closed
+    void set_out(Client& c, bool on);
+    void close_client(int fd);
+    void request_frames();
+    void publish_stats();
+
+    JpegEncoder& enc_;
+    std::string  boundary_;
+    std::string  stream_head_;   // HTTP response header of a stream
+    int          queue_len_;
+    int          max_clients_;
+
+    int listen_fd_ = -1;
+    int epoll_fd_  = -1;
+    int wake_fd_   = -1;   // eventfd: new frame or stop
+
+    std::atomic<bool> running_{false};
+    std::atomic<int>  num_streaming_{0};
+    std::thread       loop_thread_;
+
+    // event loop only
+    std::unordered_map<int, std::unique_ptr<Client>> clients_;
+    uint64_t latest_id_[REND_COUNT]  = {};
+    bool     want_frame_[REND_COUNT] = {};   // some client drained its queue this round
+
+    // encoder listener -> event loop
+    std::mutex   feed_mtx_;
+    JpegFramePtr incoming_[REND_COUNT];
+
+    mutable std::mutex             stats_mtx_;
+    std::vector<StreamClientStats> stats_;
+};
+
+#endif // MJPEG_SERVER_HPP
@@ -0,0 +1,72 @@
+#include "motion_gate.hpp"
+
+#include <algorithm>
+
+MotionGate::MotionGate(const MotionConfig& cfg)
+    : cfg_(cfg)
+{
+}
+
+// Every step is a vectorized OpenCV kernel working on a few thousand
+// pixels; with the outputs preallocated none of them allocates.
+bool MotionGate::update(const cv::Mat& bgr)
+{
+    cv::resize(bgr, small_, cv::Size(cfg_.width, cfg_.height), 0, 0, cv::INTER_AREA);
+    cv::cvtColor(small_, gray_, cv::COLOR_BGR2GRAY);
+
+    if (!have_bg_)
+    {
+        gray_.convertTo(bg_, CV_32F);
+        have_bg_ = true;
+        changed_ = 1.f;
+        rect_    = cv::Rect(0, 0, bgr.cols, bgr.rows);
+        return true;
+    }
+
+    bg_.convertTo(bg8_, CV_8U);
+    cv::absdiff(gray_, bg8_, diff_);
+    cv::compare(diff_, cfg_.pixel_thresh, mask_, cv::CMP_GT);
+    changed_ = (float)cv::countNonZero(mask_) / (float)(cfg_.width * cfg_.height);
+
+    cv::accumulateWeighted(gray_, bg_, cfg_.bg_alpha);
+
+    // coarse grid instead of contours: isolated noisy pixels don't grow the box
+    const int cw = (cfg_.width  + cfg_.cell - 1) / cfg_.cell;
+    const int ch = (cfg_.height + cfg_.cell - 1) / cfg_.cell;
+    cells_.assign((size_t)cw * ch, 0);
+    for (int y = 0; y < cfg_.height; y++)
+    {
+        const unsigned char* m = mask_.ptr<unsigned char>(y);
+        int* row = &cells_[(size_t)(y / cfg_.cell) * cw];
+        for (int x = 0; x < cfg_.width; x++)
+            row[x / cfg_.cell] += m[x] != 0;
+    }
+
+    int x0 = cw, y0 = ch, x1 = -1, y1 = -1;
+    for (int cy = 0; cy < ch; cy++)
+    {
+        for (int cx = 0; cx < cw; cx++)
+        {
+            if (cells_[(size_t)cy * cw + cx] < cfg_.cell_min)
+                continue;
+            x0 = std::min(x0, cx);
+            y0 = std::min(y0, cy);
+            x1 = std::max(x1, cx);
+            y1 = std::max(y1, cy);
+        }
+    }
+    if (x1 < 0)
+    {
+        rect_ = cv::Rect();
+    }
+    else
+    {
+        const float sx = (float)bgr.cols / cfg_.width  * cfg_.cell;
+        const float sy = (float)bgr.rows / cfg_.height * cfg_.cell;
+        rect_ = cv::Rect((int)(x0 * sx), (int)(y0 * sy),
+                         (int)((x1 + 1 - x0) * sx), (int)((y1 + 1 - y0) * sy))
+              & cv::Rect(0, 0, bgr.cols, bgr.rows);
+    }
+
+    return changed_ >= cfg_.area_thresh;
+}
@@ -0,0 +1,59 @@
+#ifndef MOTION_GATE_HPP
+#define MOTION_GATE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+struct MotionConfig
+{
+    int   width        = 80;      // working resolution (640x480 -> 80x60)
+    int   height       = 60;
+    int   pixel_thresh = 18;      // |gray - background| that counts as changed, 0..255
+    float area_thresh  = 0.004f;  // share of changed pixels that counts as motion
+    float bg_alpha     = 0.05f;   // running-average rate of the background
+    int   cell         = 8;       // motion_rect() grid, working pixels per cell side
+    int   cell_min     = 3;       // changed pixels that make a cell active
+};
+
+// Cheap change detector run before inference. Each frame is area-averaged
+// down to a small grayscale image and compared against a running-average
+// background; the frame has motion when enough pixels differ.
+//
+// Slow changes (lighting, someone standing still) fade into the
+// background, so they stop counting as motion after ~1/bg_alpha frames.
+// All buffers are sized on the first frame and reused.
+class MotionGate
+{
+public:
+    explicit MotionGate(const MotionConfig& cfg = MotionConfig());
+
+    // true if the frame differs from the background, always true on the
+    // first frame or after reset()
+    bool update(const cv::Mat& bgr);
+    void reset() { have_bg_ = false; }
+
+    float changed() const { return changed_; }   // share of changed pixels, last frame
+    // bounding box of the active cells of the last frame, frame coordinates;
+    // the whole frame on the first frame, empty when nothing changed
+    const cv::Rect& motion_rect() const { return rect_; }
+    const MotionConfig& config() const { return cfg_; }
+
+private:
+    MotionConfig cfg_;
+    bool         have_bg_ = false;
+    float        changed_ = 1.f;
+    cv::Rect     rect_;
+
+    std::vector<int> cells_;   // changed pixels per grid cell
+
+    cv::Mat small_;   // BGR, downscaled
+    cv::Mat gray_;
+    cv::Mat bg_;      // CV_32F running average
+    cv::Mat bg8_;
+    cv::Mat diff_;
+    cv::Mat mask_;
+};
+
+#endif // MOTION_GATE_HPP
@@ -0,0 +1,292 @@
+#include "nms.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "yolo-fastestv2.h"
+
+static const int kMaxGridDim   = 64;
+static const int kMinGridBoxes = 32;
+
+//  IoU helper 
+template <class B>
+static float iou(const B& a, const B& b)
+{
+    float inter_area = intersection_area(a.x1, a.y1, a.x2, a.y2,
+                                         b.x1, b.y1, b.x2, b.y2);
+    float union_area = a.area + b.area - inter_area;
+    if (union_area <= 0.f)
+        return 0.f;
+    return inter_area / union_area;
+}
+
+// max-heap on score, lower index first on ties
+static bool heapLess(const std::pair<float, int>& a, const std::pair<float, int>& b)
+{
+    return a.first < b.first || (a.first == b.first && a.second > b.second);
+}
+
+NmsEngine::NmsEngine(const NmsConfig& cfg)
+    : cfg_(cfg)
+    , grid_x0_(0.f)
+    , grid_y0_(0.f)
+    , cell_(1.f)
+    , grid_w_(0)
+    , grid_h_(0)
+    , stamp_id_(0)
+{
+    cells_.resize(kMaxGridDim * kMaxGridDim);
+}
+
+int NmsEngine::run(const std::vector<TargetBox>& candidates,
+                   std::vector<TargetBox>& dst)
+{
+    dst.clear();
+    kept_.clear();
+    if (candidates.empty())
+        return 0;
+
+    const int n = (int)candidates.size();
+    boxes_.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        const TargetBox& t = candidates[i];
+        Box& b = boxes_[i];
+        b.x1    = (float)t.x1;
+        b.y1    = (float)t.y1;
+        b.x2    = (float)t.x2;
+        b.y2    = (float)t.y2;
+        b.area  = (b.x2 - b.x1) * (b.y2 - b.y1);
+        b.score = t.score;
+        b.cate  = t.cate;
+        b.src   = i;
+    }
+
+    std::sort(boxes_.begin(), boxes_.end(), [](const Box& a, const Box& b) {
+        if (a.cate != b.cate)   return a.cate < b.cate;
+        if (a.score != b.score) return a.score > b.score;
+        return a.src < b.src;
+    });
+
+    stamp_.assign(n, 0u);
+    stamp_id_ = 0;
+
+    // one class at a time
+    for (int begin = 0; begin < n; )
+    {
+        int end = begin + 1;
+        while (end < n && boxes_[end].cate == boxes_[begin].cate)
+            end++;
+
+        build_grid(begin, end);
+        if (cfg_.method == NmsConfig::HARD)
+            run_hard(begin, end);
+        else
+            run_soft(begin, end);
+        grid_clear();
+
+        begin = end;
+    }
+
+    // merge classes back into score order
+    std::sort(kept_.begin(), kept_.end(), [this](int a, int b) {
+        if (boxes_[a].score != boxes_[b].score)
+            return boxes_[a].score > boxes_[b].score;
+        return boxes_[a].src < boxes_[b].src;
+    });
+    if (cfg_.top_k > 0 && (int)kept_.size() > cfg_.top_k)
+        kept_.resize(cfg_.top_k);
+
+    dst.reserve(kept_.size());
+    for (size_t i = 0; i < kept_.size(); i++)
+    {
+        const Box& b = boxes_[kept_[i]];
+        TargetBox t = candidates[b.src];
+        t.score = b.score;
+        dst.push_back(t);
+    }
+    return 0;
+}
+
+//  grid 
+// Cell size tracks the typical box size of the class so a box spans a
+// handful of cells; the grid is capped at kMaxGridDim per axis.
+void NmsEngine::build_grid(int begin, int end)
+{
+    float minX = boxes_[begin].x1, minY = boxes_[begin].y1;
+    float maxX = boxes_[begin].x2, maxY = boxes_[begin].y2;
+    float sumDim = 0.f;
+    for (int i = begin; i < end; i++)
+    {
+        const Box& b = boxes_[i];
+        minX = std::min(minX, b.x1);
+        minY = std::min(minY, b.y1);
+        maxX = std::max(maxX, b.x2);
+        maxY = std::max(maxY, b.y2);
+        sumDim += std::max(b.x2 - b.x1, b.y2 - b.y1);
+    }
+
+    float spanX = std::max(maxX - minX, 1.f);
+    float spanY = std::max(maxY - minY, 1.f);
+
+    cell_ = std::max(sumDim / (float)(end - begin), 8.f);
+    cell_ = std::max(cell_, std::max(spanX, spanY) / (float)kMaxGridDim);
+
+    grid_x0_ = minX;
+    grid_y0_ = minY;
+    grid_w_  = std::min((int)(spanX / cell_) + 1, kMaxGridDim);
+    grid_h_  = std::min((int)(spanY / cell_) + 1, kMaxGridDim);
+
+    // a handful of boxes: one cell, i.e. the plain linear scan
+    if (end - begin < kMinGridBoxes)
+        grid_w_ = grid_h_ = 1;
+}
+
+void NmsEngine::cell_range(const Box& b, int& cx0, int& cy0, int& cx1, int& cy1) const
+{
+    const float inv = 1.f / cell_;
+    cx0 = std::max(0, std::min(grid_w_ - 1, (int)((b.x1 - grid_x0_) * inv)));
+    cy0 = std::max(0, std::min(grid_h_ - 1, (int)((b.y1 - grid_y0_) * inv)));
+    cx1 = std::max(0, std::min(grid_w_ - 1, (int)((b.x2 - grid_x0_) * inv)));
+    cy1 = std::max(0, std::min(grid_h_ - 1, (int)((b.y2 - grid_y0_) * inv)));
+}
+
+void NmsEngine::grid_insert(int idx)
+{
+    int cx0, cy0, cx1, cy1;
+    cell_range(boxes_[idx], cx0, cy0, cx1, cy1);
+    for (int cy = cy0; cy <= cy1; cy++)
+    {
+        for (int cx = cx0; cx <= cx1; cx++)
+        {
+            std::vector<int>& cell = cells_[cy * kMaxGridDim + cx];
+            if (cell.empty())
+                touched_.push_back(cy * kMaxGridDim + cx);
+            cell.push_back(idx);
+        }
+    }
+}
+
+void NmsEngine::grid_clear()
+{
+    for (size_t i = 0; i < touched_.size(); i++)
+        cells_[touched_[i]].clear();
+    touched_.clear();
+}
+
+//  hard NMS 
+void NmsEngine::run_hard(int begin, int end)
+{
+    int kept = 0;
+    for (int i = begin; i < end; i++)
+    {
+        if (cfg_.top_k > 0 && kept == cfg_.top_k)
+            break;
+
+        const Box& b = boxes_[i];
+        int cx0, cy0, cx1, cy1;
+        cell_range(b, cx0, cy0, cx1, cy1);
+
+        stamp_id_++;
+        bool keep = true;
+        for (int cy = cy0; cy <= cy1 && keep; cy++)
+        {
+            for (int cx = cx0; cx <= cx1 && keep; cx++)
+            {
+                const std::vector<int>& cell = cells_[cy * kMaxGridDim + cx];
+                for (size_t k = 0; k < cell.size(); k++)
+                {
+                    int j = cell[k];
+                    if (stamp_[j] == stamp_id_)
+                        continue;
+                    stamp_[j] = stamp_id_;
+                    if (iou(b, boxes_[j]) > cfg_.iou_thresh)
+                    {
+                        keep = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (keep)
+        {
+            kept_.push_back(i);
+            grid_insert(i);
+            kept++;
+        }
+    }
+}
+
+//  Soft-NMS 
+// All candidates of the class sit in the grid; each kept box decays only
+// the live neighbours sharing a cell with it. A lazy max-heap tracks the
+// next best box, stale entries are skipped when popped.
+void NmsEngine::run_soft(int begin, int end)
+{
+    alive_.assign(end - begin, 1);
+    heap_.clear();
+    for (int i = begin; i < end; i++)
+    {
+        grid_insert(i);
+        heap_.push_back(std::make_pair(boxes_[i].score, i));
+    }
+    std::make_heap(heap_.begin(), heap_.end(), heapLess);
+
+    int kept = 0;
+    while (!heap_.empty())
+    {
+        std::pop_heap(heap_.begin(), heap_.end(), heapLess);
+        std::pair<float, int> top = heap_.back();
+        heap_.pop_back();
+
+        int i = top.second;
+        if (!alive_[i - begin] || top.first != boxes_[i].score)
+            continue;
+        if (top.first < cfg_.score_thresh)
+            break;
+
+        alive_[i - begin] = 0;
+        kept_.push_back(i);
+        if (cfg_.top_k > 0 && ++kept == cfg_.top_k)
+            break;
+
+        const Box& b = boxes_[i];
+        int cx0, cy0, cx1, cy1;
+        cell_range(b, cx0, cy0, cx1, cy1);
+
+        stamp_id_++;
+        for (int cy = cy0; cy <= cy1; cy++)
+        {
+            for (int cx = cx0; cx <= cx1; cx++)
+            {
+                const std::vector<int>& cell = cells_[cy * kMaxGridDim + cx];
+                for (size_t k = 0; k < cell.size(); k++)
+                {
+                    int j = cell[k];
+                    if (!alive_[j - begin] || stamp_[j] == stamp_id_)
+                        continue;
+                    stamp_[j] = stamp_id_;
+
+                    float ov = iou(b, boxes_[j]);
+                    float w  = 1.f;
+                    if (cfg_.method == NmsConfig::SOFT_LINEAR)
+                        w = (ov > cfg_.iou_thresh) ? 1.f - ov : 1.f;
+                    else
+                        w = std::exp(-(ov * ov) / cfg_.sigma);
+                    if (w >= 1.f)
+                        continue;
+
+                    boxes_[j].score *= w;
+                    if (boxes_[j].score < cfg_.score_thresh)
+                        alive_[j - begin] = 0;
+                    else
+                    {
+                        heap_.push_back(std::make_pair(boxes_[j].score, j));
+                        std::push_heap(heap_.begin(), heap_.end(), heapLess);
+                    }
+                }
+            }
+        }
+    }
+}
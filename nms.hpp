@@ -0,0 +1,88 @@
+#ifndef NMS_HPP
+#define NMS_HPP
+
+#include <utility>
+#include <vector>
+
+class TargetBox;
+
+// Overlap area of two boxes given as corners, 0 if they are disjoint.
+// Inline so NMS and the microbenchmarks share one definition.
+inline float intersection_area(float ax1, float ay1, float ax2, float ay2,
+                               float bx1, float by1, float bx2, float by2)
+{
+    if (ax1 > bx2 || ax2 < bx1 || ay1 > by2 || ay2 < by1)
+        return 0.f;
+
+    float inter_width  = (ax2 < bx2 ? ax2 : bx2) - (ax1 > bx1 ? ax1 : bx1);
+    float inter_height = (ay2 < by2 ? ay2 : by2) - (ay1 > by1 ? ay1 : by1);
+
+    return inter_width * inter_height;
+}
+
+struct NmsConfig
+{
+    enum Method { HARD, SOFT_LINEAR, SOFT_GAUSSIAN };
+
+    Method method       = HARD;
+    float  iou_thresh   = 0.25f;   // hard: suppress above, linear: decay above
+    float  sigma        = 0.5f;    // gaussian decay: exp(-iou^2 / sigma)
+    float  score_thresh = 0.001f;  // soft: drop a box once decayed below this
+    int    top_k        = 0;       // stop after top_k boxes, 0 = no limit
+};
+
+// Greedy NMS over detector candidates.
+//  - candidates are partitioned by class, classes never suppress each other
+//  - kept boxes go into a uniform grid so a candidate is only IoU-tested
+//    against kept boxes in the cells it overlaps
+//  - geometry is float internally
+//  - all scratch lives in the engine; no allocation once warmed up
+class NmsEngine
+{
+public:
+    explicit NmsEngine(const NmsConfig& cfg = NmsConfig());
+
+    void             set_config(const NmsConfig& cfg) { cfg_ = cfg; }
+    const NmsConfig& config() const { return cfg_; }
+
+    // dst: survivors sorted by (possibly decayed) score, best first
+    int run(const std::vector<TargetBox>& candidates,
+            std::vector<TargetBox>& dst);
+
+private:
+    struct Box {
+        float x1, y1, x2, y2;
+        float area;
+        float score;
+        int   cate;
+        int   src;   // index into candidates
+    };
+
+    void build_grid(int begin, int end);
+    void cell_range(const Box& b, int& cx0, int& cy0, int& cx1, int& cy1) const;
+    void grid_insert(int idx);
+    void grid_clear();
+
+    void run_hard(int begin, int end);
+    void run_soft(int begin, int end);
+
+    NmsConfig cfg_;
+
+    std::vector<Box> boxes_;   // working copy, sorted by (cate, score desc)
+    std::vector<int> kept_;    // indices into boxes_
+
+    float                         grid_x0_;
+    float                         grid_y0_;
+    float                         cell_;
+    int                           grid_w_;
+    int                           grid_h_;
+    std::vector<std::vector<int>> cells_;
+    std::vector<int>              touched_;   // non-empty cells to clear
+    std::vector<unsigned>         stamp_;     // per box, dedupes a grid query
+    unsigned                      stamp_id_;
+
+    std::vector<std::pair<float, int>> heap_;   // soft: (score, box)
+    std::vector<char>                  alive_;
+};
+
+#endif // NMS_HPP
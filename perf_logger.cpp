@@ -0,0 +1,170 @@
+#include "PerfLogger.hpp"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace perf_detail {
+
+static const int    kDrainMs   = 20;
+static const size_t kBatch     = 512;
+static const size_t kMaxNameLen = 23;   // fits the 24 payload bytes with its NUL
+
+static const char* const kFixedNames[N_FIXED] = {
+    "t_cam", "t_pp", "t_det_s", "t_det_e", "t_dec", "t_aud", "ran_infer"
+};
+
+//  registry + writer
+class Writer
+{
+public:
+    Writer()
+    {
+        for (int i = 0; i < N_FIXED; i++)
+            names_.push_back(kFixedNames[i]);
+    }
+
+    ~Writer() { stop(); }
+
+    Ring* add_thread()
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        rings_.emplace_back(new Ring((uint16_t)rings_.size()));
+        return rings_.back().get();
+    }
+
+    uint16_t intern(const char* name)
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (size_t i = 0; i < names_.size(); i++)
+            if (names_[i] == name) return (uint16_t)i;
+        names_.push_back(std::string(name).substr(0, kMaxNameLen));
+        return (uint16_t)(names_.size() - 1);
+    }
+
+    void start(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (file_) return;
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_) {
+            std::perror(path.c_str());
+            return;
+        }
+        char head[16];
+        std::memcpy(head, kMagic, 8);
+        const uint32_t ver = kVersion, size = sizeof(Record);
+        std::memcpy(head + 8, &ver, 4);
+        std::memcpy(head + 12, &size, 4);
+        std::fwrite(head, 1, sizeof(head), file_);
+        running_ = true;
+        thread_  = std::thread(&Writer::run, this);
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            if (!running_) return;
+            running_ = false;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) thread_.join();
+        drain();   // whatever came in after the last round
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        while (running_) {
+            cv_.wait_for(lk, std::chrono::milliseconds(kDrainMs));
+            lk.unlock();
+            drain();
+            lk.lock();
+        }
+    }
+
+    // REC_NAME for every name interned so far. Called after a batch is
+    // popped and before it is written: a record's name was interned before
+    // the record was pushed, so it is in names_ by now.
+    void write_names()
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (size_t i = names_written_; i < names_.size(); i++) {
+            Record r;
+            std::memset(&r, 0, sizeof(r));
+            std::memcpy(&r, names_[i].c_str(), names_[i].size());   // into t_ns/frame/aux
+            r.name = (uint16_t)i;
+            r.type = REC_NAME;
+            std::fwrite(&r, sizeof(r), 1, file_);
+        }
+        names_written_ = names_.size();
+    }
+
+    // writer thread (or stop() once it has joined)
+    void drain()
+    {
+        std::vector<Ring*> rings;
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            for (size_t i = 0; i < rings_.size(); i++)
+                rings.push_back(rings_[i].get());
+        }
+        dropped_seen_.resize(rings.size(), 0);
+
+        for (size_t i = 0; i < rings.size(); i++) {
+            size_t n;
+            while ((n = rings[i]->pop(batch_, kBatch)) > 0) {
+                write_names();
+                std::fwrite(batch_, sizeof(Record), n, file_);
+            }
+
+            uint64_t dropped = rings[i]->dropped();
+            if (dropped != dropped_seen_[i]) {
+                Record r;
+                std::memset(&r, 0, sizeof(r));
+                r.t_ns   = now_ns();
+                r.frame  = -1;
+                r.aux    = dropped;
+                r.thread = rings[i]->thread();
+                r.type   = REC_DROPPED;
+                std::fwrite(&r, sizeof(r), 1, file_);
+                dropped_seen_[i] = dropped;
+            }
+        }
+        std::fflush(file_);
+    }
+
+    std::mutex                         mtx_;   // registry and names, never taken per record
+    std::condition_variable            cv_;
+    std::vector<std::unique_ptr<Ring>> rings_;
+    std::vector<std::string>           names_;
+    size_t                             names_written_ = 0;
+    bool                               running_ = false;
+    FILE*                              file_ = nullptr;
+    std::thread                        thread_;
+
+    // writer only
+    Record                batch_[kBatch];
+    std::vector<uint64_t> dropped_seen_;
+};
+
+static Writer& writer()
+{
+    static Writer w;
+    return w;
+}
+
+Ring*    register_thread()              { return writer().add_thread(); }
+uint16_t intern(const char* name)       { return writer().intern(name); }
+void     init(const std::string& path)  { writer().start(path); }
+void     shutdown()                     { writer().stop(); }
+
+} // namespace perf_detail
@@ -0,0 +1,210 @@
+#include "pipeline.hpp"
+
+#include <algorithm>
+
+using clock_type = std::chrono::steady_clock;
+
+static uint64_t ns_since(clock_type::time_point t0)
+{
+    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - t0).count();
+    return ns > 0 ? (uint64_t)ns : 0;
+}
+
+const char* edge_policy_name(EdgePolicy p)
+{
+    switch (p) {
+    case EDGE_BLOCK:       return "block";
+    case EDGE_DROP_OLDEST: return "drop-oldest";
+    case EDGE_KEEP_LATEST: return "keep-latest";
+    }
+    return "?";
+}
+
+namespace pipeline_detail {
+
+thread_local uint64_t tl_wait_ns = 0;
+
+struct Stage
+{
+    std::string                        name;
+    std::function<void(StageContext&)> body;
+    std::thread                        thread;
+
+    std::atomic<bool>     running{false};
+    std::atomic<uint64_t> items{0};
+    std::atomic<uint64_t> busy_ns{0};
+    std::atomic<uint64_t> wait_ns{0};
+    LatencyHistogram      busy;
+};
+
+bool Notifier::wait(uint64_t key, clock_type::time_point deadline, bool forever)
+{
+    const auto t0 = clock_type::now();
+    bool woke = true;
+    {
+        std::unique_lock<std::mutex> lk(mtx_);
+        auto moved = [&] { return epoch_.load() != key; };
+        if (forever)
+            cv_.wait(lk, moved);
+        else
+            woke = cv_.wait_until(lk, deadline, moved);
+    }
+    waiters_.fetch_sub(1);
+    tl_wait_ns += ns_since(t0);
+    return woke;
+}
+
+} // namespace pipeline_detail
+
+//  edges
+void EdgeBase::close()
+{
+    closed_.store(true, std::memory_order_release);
+    not_empty_.notify();
+    not_full_.notify();
+}
+
+bool EdgeBase::wait(pipeline_detail::Notifier& n, uint64_t key, int timeout_ms,
+                    clock_type::time_point t0)
+{
+    return n.wait(key, t0 + std::chrono::milliseconds(timeout_ms < 0 ? 0 : timeout_ms), timeout_ms < 0);
+}
+
+void EdgeBase::count_push(size_t depth)
+{
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+    size_t m = max_depth_.load(std::memory_order_relaxed);
+    while (depth > m && !max_depth_.compare_exchange_weak(m, depth, std::memory_order_relaxed)) {}
+}
+
+EdgeStats EdgeBase::stats() const
+{
+    EdgeStats s;
+    s.name      = name_;
+    s.policy    = policy_;
+    s.capacity  = capacity();
+    s.depth     = depth();
+    s.max_depth = max_depth_.load(std::memory_order_relaxed);
+    s.pushed    = pushed_.load(std::memory_order_relaxed);
+    s.popped    = popped_.load(std::memory_order_relaxed);
+    s.dropped   = dropped_.load(std::memory_order_relaxed);
+    return s;
+}
+
+//  stages
+StageContext::StageContext(Pipeline& p, pipeline_detail::Stage& s)
+    : pipe_(p), stage_(s), t_item_(clock_type::now())
+{
+    pipeline_detail::tl_wait_ns = 0;
+}
+
+bool StageContext::running() const
+{
+    return pipe_.running();
+}
+
+void StageContext::item()
+{
+    const auto now = clock_type::now();
+    long long span = std::chrono::duration_cast<std::chrono::nanoseconds>(now - t_item_).count();
+    const uint64_t total = span > 0 ? (uint64_t)span : 0;
+    const uint64_t waited = std::min(pipeline_detail::tl_wait_ns, total);
+    pipeline_detail::tl_wait_ns = 0;
+    t_item_ = now;
+
+    stage_.items.fetch_add(1, std::memory_order_relaxed);
+    stage_.busy_ns.fetch_add(total - waited, std::memory_order_relaxed);
+    stage_.wait_ns.fetch_add(waited, std::memory_order_relaxed);
+    stage_.busy.record_ns(total - waited);
+}
+
+StageContext::Wait::~Wait()
+{
+    pipeline_detail::tl_wait_ns += ns_since(t0_);
+}
+
+Pipeline::Pipeline()
+{
+}
+
+Pipeline::~Pipeline()
+{
+    stop();
+}
+
+void Pipeline::add_stage(const std::string& name, std::function<void(StageContext&)> body)
+{
+    std::unique_ptr<pipeline_detail::Stage> s(new pipeline_detail::Stage);
+    s->name = name;
+    s->body = std::move(body);
+    stages_.push_back(std::move(s));
+}
+
+void Pipeline::start()
+{
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        ended_ = false;
+    }
+    running_.store(true, std::memory_order_release);
+    for (auto& s : stages_) {
+        s->running.store(true, std::memory_order_relaxed);
+        pipeline_detail::Stage* sp = s.get();
+        s->thread = std::thread([this, sp] { run_stage(*sp); });
+    }
+}
+
+void Pipeline::run_stage(pipeline_detail::Stage& s)
+{
+    StageContext ctx(*this, s);
+    s.body(ctx);
+    s.running.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        ended_ = true;
+    }
+    cv_.notify_all();
+}
+
+void Pipeline::wait()
+{
+    std::unique_lock<std::mutex> lk(mtx_);
+    cv_.wait(lk, [this] { return ended_; });
+}
+
+void Pipeline::request_stop()
+{
+    running_.store(false, std::memory_order_release);
+    for (auto& e : edges_)
+        e->close();
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        ended_ = true;
+    }
+    cv_.notify_all();
+}
+
+void Pipeline::join()
+{
+    for (auto& s : stages_)
+        if (s->thread.joinable())
+            s->thread.join();
+}
+
+void Pipeline::stats(std::vector<StageStats>& stages, std::vector<EdgeStats>& edges) const
+{
+    stages.clear();
+    for (const auto& s : stages_) {
+        StageStats st;
+        st.name    = s->name;
+        st.running = s->running.load(std::memory_order_relaxed);
+        st.items   = s->items.load(std::memory_order_relaxed);
+        st.busy_ns = s->busy_ns.load(std::memory_order_relaxed);
+        st.wait_ns = s->wait_ns.load(std::memory_order_relaxed);
+        st.busy    = &s->busy;
+        stages.push_back(st);
+    }
+    edges.clear();
+    for (const auto& e : edges_)
+        edges.push_back(e->stats());
+}
@@ -0,0 +1,461 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "metrics.hpp"
+
+// Stage graph runtime: named stages, one thread each, connected by typed
+// edges. The data path of an edge is lock-free; a mutex is only taken by
+// a side that has nothing to do and goes to sleep, and by the side that
+// wakes it.
+//
+//   Pipeline p;
+//   Edge<FramePacket>* frames = p.add_edge<FramePacket>("frames", EDGE_KEEP_LATEST);
+//   p.add_stage("camera",   [&](StageContext& c) { while (c.running()) { ...; frames->push(pkt); c.item(); } });
+//   p.add_stage("dispatch", [&](StageContext& c) { FramePacket pkt; while (frames->pop(pkt)) { ...; c.item(); } });
+//   p.start(); p.wait(); p.stop();
+//
+// Edge policies:
+//   EDGE_BLOCK        bounded queue, a full queue blocks the producer
+//   EDGE_DROP_OLDEST  bounded queue, a full queue drops its oldest item
+//   EDGE_KEEP_LATEST  one-item mailbox, a new item replaces an unread one
+//                     (one producer; the value a consumer pops out is
+//                     swapped for the one it passed in, so buffers are reused)
+enum EdgePolicy { EDGE_BLOCK, EDGE_DROP_OLDEST, EDGE_KEEP_LATEST };
+
+const char* edge_policy_name(EdgePolicy p);
+
+struct EdgeStats
+{
+    std::string name;
+    EdgePolicy  policy = EDGE_BLOCK;
+    size_t      capacity = 0;
+    size_t      depth = 0;
+    size_t      max_depth = 0;
+    uint64_t    pushed = 0;
+    uint64_t    popped = 0;
+    uint64_t    dropped = 0;   // overwritten / evicted, never popped
+};
+
+struct StageStats
+{
+    std::string             name;
+    bool                    running = false;
+    uint64_t                items = 0;
+    uint64_t                busy_ns = 0;
+    uint64_t                wait_ns = 0;   // blocked in edges or StageContext::Wait
+    const LatencyHistogram* busy = nullptr;   // per item, owned by the pipeline
+};
+
+namespace pipeline_detail {
+
+// Eventcount: waiters announce themselves, re-check their condition and
+// sleep until the epoch moves; notify() is an atomic increment and only
+// locks when someone sleeps.
+class Notifier
+{
+public:
+    uint64_t prepare_wait()
+    {
+        waiters_.fetch_add(1);
+        return epoch_.load();
+    }
+    void cancel_wait() { waiters_.fetch_sub(1); }
+    bool wait(uint64_t key, std::chrono::steady_clock::time_point deadline, bool forever);   // false on timeout
+    void notify()
+    {
+        epoch_.fetch_add(1);
+        if (waiters_.load() > 0) {
+            std::lock_guard<std::mutex> lk(mtx_);
+            cv_.notify_all();
+        }
+    }
+
+private:
+    std::atomic<uint64_t>   epoch_{0};
+    std::atomic<int>        waiters_{0};
+    std::mutex              mtx_;
+    std::condition_variable cv_;
+};
+
+// Bounded lock-free queue (Vyukov): any number of producers and consumers,
+// so a producer may also evict (drop-oldest).
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+    {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        mask_  = n - 1;
+        cells_.reset(new Cell[n]);
+        for (size_t i = 0; i < n; i++)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return mask_ + 1; }
+    size_t size() const
+    {
+        const size_t e = enq_.load(std::memory_order_relaxed), d = deq_.load(std::memory_order_relaxed);
+        return e > d ? e - d : 0;
+    }
+
+    template <class U>
+    bool try_push(U&& v)
+    {
+        size_t pos = enq_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells_[pos & mask_];
+            const size_t seq = c.seq.load(std::memory_order_acquire);
+            const intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (enq_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.data = std::forward<U>(v);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;   // full
+            } else {
+                pos = enq_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& out)
+    {
+        size_t pos = deq_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& c = cells_[pos & mask_];
+            const size_t seq = c.seq.load(std::memory_order_acquire);
+            const intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (deq_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(c.data);
+                    c.data = T();   // drop what the moved-from value still holds (frame refs)
+                    c.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;   // empty
+            } else {
+                pos = deq_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T                   data;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t                  mask_ = 0;
+    char                    pad0_[64];
+    std::atomic<size_t>     enq_{0};
+    char                    pad1_[64];
+    std::atomic<size_t>     deq_{0};
+};
+
+// per-thread: time the running stage spent blocked, see StageContext
+extern thread_local uint64_t tl_wait_ns;
+
+struct Stage;   // pipeline.cpp
+
+} // namespace pipeline_detail
+
+//  edges
+class EdgeBase
+{
+public:
+    EdgeBase(const std::string& name, EdgePolicy policy) : name_(name), policy_(policy) {}
+    virtual ~EdgeBase() {}
+
+    const std::string& name() const { return name_; }
+    EdgePolicy policy() const { return policy_; }
+    virtual size_t capacity() const = 0;
+    virtual size_t depth() const = 0;
+
+    // wakes everyone; push fails from now on, pop drains what is left
+    void close();
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    uint64_t  dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    EdgeStats stats() const;
+
+protected:
+    // false on timeout (timeout_ms < 0: none)
+    bool wait(pipeline_detail::Notifier& n, uint64_t key, int timeout_ms,
+              std::chrono::steady_clock::time_point t0);
+    void count_push(size_t depth);
+
+    const std::string name_;
+    const EdgePolicy  policy_;
+    std::atomic<bool> closed_{false};
+
+    pipeline_detail::Notifier not_empty_;
+    pipeline_detail::Notifier not_full_;
+
+    std::atomic<uint64_t> pushed_{0};
+    std::atomic<uint64_t> popped_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<size_t>   max_depth_{0};
+};
+
+template <class T>
+class Edge : public EdgeBase
+{
+public:
+    using EdgeBase::EdgeBase;
+
+    // false once the edge is closed (the item is not delivered)
+    virtual bool push(const T& v) = 0;
+    virtual bool push(T&& v) = 0;
+    // false on timeout, or when closed and empty; timeout_ms < 0 waits for ever
+    virtual bool pop(T& out, int timeout_ms = -1) = 0;
+    virtual bool try_pop(T& out) = 0;
+};
+
+template <class T>
+class QueueEdge : public Edge<T>
+{
+public:
+    QueueEdge(const std::string& name, EdgePolicy policy, size_t capacity)
+        : Edge<T>(name, policy), q_(capacity) {}
+
+    size_t capacity() const override { return q_.capacity(); }
+    size_t depth() const override { return q_.size(); }
+
+    bool push(const T& v) override { return put(v); }
+    bool push(T&& v) override { return put(std::move(v)); }
+
+    bool pop(T& out, int timeout_ms) override
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (;;) {
+            if (take(out))
+                return true;
+            const uint64_t key = this->not_empty_.prepare_wait();
+            if (take(out)) {
+                this->not_empty_.cancel_wait();
+                return true;
+            }
+            if (this->closed()) {
+                this->not_empty_.cancel_wait();
+                return false;
+            }
+            if (!this->wait(this->not_empty_, key, timeout_ms, t0))
+                return take(out);
+        }
+    }
+    bool try_pop(T& out) override { return take(out); }
+
+private:
+    bool take(T& out)
+    {
+        if (!q_.try_pop(out))
+            return false;
+        this->popped_.fetch_add(1, std::memory_order_relaxed);
+        if (this->policy_ == EDGE_BLOCK)
+            this->not_full_.notify();
+        return true;
+    }
+
+    template <class U>
+    bool put(U&& v)
+    {
+        for (;;) {
+            if (this->closed())
+                return false;
+            if (q_.try_push(std::forward<U>(v)))
+                break;
+            if (this->policy_ == EDGE_DROP_OLDEST) {
+                T victim;
+                if (q_.try_pop(victim))
+                    this->dropped_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            // EDGE_BLOCK: sleep until a consumer makes room
+            const uint64_t key = this->not_full_.prepare_wait();
+            if (this->closed() || q_.size() < q_.capacity()) {
+                this->not_full_.cancel_wait();
+                continue;
+            }
+            this->wait(this->not_full_, key, -1, std::chrono::steady_clock::now());
+        }
+        this->count_push(q_.size());
+        this->not_empty_.notify();
+        return true;
+    }
+
+    pipeline_detail::BoundedQueue<T> q_;
+};
+
+// Triple buffer: the producer writes a back slot and swaps it with the
+// middle one, the consumer swaps its front slot with the middle one when
+// that holds something new. Neither side ever waits for the other.
+template <class T>
+class MailboxEdge : public Edge<T>
+{
+public:
+    explicit MailboxEdge(const std::string& name) : Edge<T>(name, EDGE_KEEP_LATEST) {}
+
+    size_t capacity() const override { return 1; }
+    size_t depth() const override { return (mid_.load(std::memory_order_relaxed) & kFresh) ? 1 : 0; }
+
+    bool push(const T& v) override
+    {
+        if (this->closed()) return false;
+        slots_[back_] = v;   // copy-assign keeps the slot's buffers
+        return publish();
+    }
+    bool push(T&& v) override
+    {
+        if (this->closed()) return false;
+        slots_[back_] = std::move(v);
+        return publish();
+    }
+
+    bool pop(T& out, int timeout_ms) override
+    {
+        const auto t0 = std::chrono::steady_clock::now();
+        for (;;) {
+            if (take(out))
+                return true;
+            const uint64_t key = this->not_empty_.prepare_wait();
+            if (take(out)) {
+                this->not_empty_.cancel_wait();
+                return true;
+            }
+            if (this->closed()) {
+                this->not_empty_.cancel_wait();
+                return false;
+            }
+            if (!this->wait(this->not_empty_, key, timeout_ms, t0))
+                return take(out);
+        }
+    }
+    bool try_pop(T& out) override { return take(out); }
+
+private:
+    static const unsigned kFresh = 4;
+
+    bool publish()
+    {
+        const unsigned prev = mid_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+        back_ = prev & 3;
+        if (prev & kFresh)
+            this->dropped_.fetch_add(1, std::memory_order_relaxed);   // never read, still in back_ until the next push
+        this->count_push(1);
+        this->not_empty_.notify();
+        return true;
+    }
+
+    bool take(T& out)
+    {
+        if (!(mid_.load(std::memory_order_acquire) & kFresh))
+            return false;
+        const unsigned prev = mid_.exchange(front_, std::memory_order_acq_rel);
+        front_ = prev & 3;
+        using std::swap;
+        swap(out, slots_[front_]);
+        this->popped_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    T                     slots_[3];
+    unsigned              back_  = 0;   // producer
+    std::atomic<unsigned> mid_{1};
+    unsigned              front_ = 2;   // consumer
+};
+
+//  stages
+class Pipeline;
+
+// Handed to a stage body. Call item() after each unit of work: the time
+// since the previous item() minus the time blocked on edges (or inside a
+// Wait scope) is that item's busy time.
+class StageContext
+{
+public:
+    bool running() const;
+    void item();
+
+    // blocking outside the edges (device read, another component's queue)
+    class Wait
+    {
+    public:
+        Wait() : t0_(std::chrono::steady_clock::now()) {}
+        ~Wait();
+        Wait(const Wait&) = delete;
+        Wait& operator=(const Wait&) = delete;
+    private:
+        std::chrono::steady_clock::time_point t0_;
+    };
+
+private:
+    friend class Pipeline;
+    StageContext(Pipeline& p, pipeline_detail::Stage& s);
+
+    Pipeline&                             pipe_;
+    pipeline_detail::Stage&               stage_;
+    std::chrono::steady_clock::time_point t_item_;
+};
+
+class Pipeline
+{
+public:
+    Pipeline();
+    ~Pipeline();
+    Pipeline(const Pipeline&) = delete;
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    // before start(); capacity is ignored for EDGE_KEEP_LATEST
+    template <class T>
+    Edge<T>* add_edge(const std::string& name, EdgePolicy policy, size_t capacity = 4)
+    {
+        Edge<T>* e = policy == EDGE_KEEP_LATEST
+                   ? static_cast<Edge<T>*>(new MailboxEdge<T>(name))
+                   : static_cast<Edge<T>*>(new QueueEdge<T>(name, policy, capacity));
+        edges_.emplace_back(e);
+        return e;
+    }
+
+    // the body runs once on its own thread; returning ends the stage, and
+    // the first stage to end makes wait() return
+    void add_stage(const std::string& name, std::function<void(StageContext&)> body);
+
+    void start();
+    bool running() const { return running_.load(std::memory_order_acquire); }
+    void wait();           // until request_stop() or a stage returns
+    void request_stop();   // running() turns false, edges close and wake their waiters
+    void join();
+    void stop() { request_stop(); join(); }
+
+    void stats(std::vector<StageStats>& stages, std::vector<EdgeStats>& edges) const;
+
+private:
+    void run_stage(pipeline_detail::Stage& s);
+
+    std::vector<std::unique_ptr<EdgeBase>>               edges_;
+    std::vector<std::unique_ptr<pipeline_detail::Stage>> stages_;
+    std::atomic<bool>       running_{false};
+    std::mutex              mtx_;
+    std::condition_variable cv_;
+    bool                    ended_ = false;   // a stage returned or stop requested
+};
+
+#endif // PIPELINE_HPP
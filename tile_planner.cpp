@@ -0,0 +1,114 @@
+#include "tile_planner.hpp"
+
+#include <algorithm>
+
+TilePlanner::TilePlanner(int frame_w, int frame_h, const TileConfig& cfg)
+    : frame_w_(frame_w), frame_h_(frame_h), cfg_(cfg)
+{
+}
+
+bool TilePlanner::plan(const cv::Rect& motion, const std::vector<TargetBox>& tracked,
+                       std::vector<cv::Rect>& tiles)
+{
+    const cv::Rect frame(0, 0, frame_w_, frame_h_);
+    tiles.clear();
+
+    cv::Rect focus = motion;
+    for (size_t i = 0; i < tracked.size(); i++)
+    {
+        const TargetBox& b = tracked[i];
+        cv::Rect r(b.x1, b.y1, b.x2 - b.x1, b.y2 - b.y1);
+        focus = (focus.area() > 0) ? (focus | r) : r;
+    }
+    focus &= frame;
+    const bool use_focus = cfg_.follow_motion && focus.area() > 0;
+
+    if (cfg_.zones.empty())
+    {
+        if (!use_focus)
+            return true;
+        tiles.push_back(fit(focus));
+    }
+    else
+    {
+        for (size_t i = 0; i < cfg_.zones.size(); i++)
+        {
+            cv::Rect r = cfg_.zones[i] & frame;
+            if (use_focus)
+                r &= focus;
+            if (r.area() > 0)
+                tiles.push_back(fit(r));
+        }
+        if (tiles.empty())
+            return false;
+    }
+
+    // overlapping crops would infer the same pixels twice: merge them
+    for (bool merged = true; merged; )
+    {
+        merged = false;
+        for (size_t i = 0; i < tiles.size() && !merged; i++)
+        {
+            for (size_t j = i + 1; j < tiles.size(); j++)
+            {
+                if ((tiles[i] & tiles[j]).area() == 0)
+                    continue;
+                tiles[i] |= tiles[j];
+                tiles.erase(tiles.begin() + j);
+                merged = true;
+                break;
+            }
+        }
+    }
+
+    long cover = 0;
+    for (size_t i = 0; i < tiles.size(); i++)
+        cover += (long)tiles[i].area();
+    if ((int)tiles.size() > cfg_.max_tiles || cover > cfg_.max_cover * frame.area())
+        tiles.clear();
+    return true;
+}
+
+// pad, grow to min_side, then shift (or clip) into the frame
+cv::Rect TilePlanner::fit(const cv::Rect& region) const
+{
+    int px = (int)(region.width  * cfg_.pad);
+    int py = (int)(region.height * cfg_.pad);
+    cv::Rect r(region.x - px, region.y - py, region.width + 2 * px, region.height + 2 * py);
+
+    if (r.width < cfg_.min_side)
+    {
+        r.x    -= (cfg_.min_side - r.width) / 2;
+        r.width = cfg_.min_side;
+    }
+    if (r.height < cfg_.min_side)
+    {
+        r.y     -= (cfg_.min_side - r.height) / 2;
+        r.height = cfg_.min_side;
+    }
+
+    r.width  = std::min(r.width,  frame_w_);
+    r.height = std::min(r.height, frame_h_);
+    r.x = std::max(0, std::min(r.x, frame_w_ - r.width));
+    r.y = std::max(0, std::min(r.y, frame_h_ - r.height));
+    return r;
+}
+
+void TilePlanner::filter(std::vector<TargetBox>& boxes) const
+{
+    if (cfg_.zones.empty())
+        return;
+
+    const std::vector<cv::Rect>& zones = cfg_.zones;
+    boxes.erase(std::remove_if(boxes.begin(), boxes.end(), [&zones](const TargetBox& b) {
+        int cx = (b.x1 + b.x2) / 2;
+        int cy = (b.y1 + b.y2) / 2;
+        for (size_t i = 0; i < zones.size(); i++)
+        {
+            const cv::Rect& z = zones[i];
+            if (cx >= z.x && cx < z.x + z.width && cy >= z.y && cy < z.y + z.height)
+                return false;
+        }
+        return true;
+    }), boxes.end());
+}
@@ -0,0 +1,51 @@
+#ifndef TILE_PLANNER_HPP
+#define TILE_PLANNER_HPP
+
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "yolo-fastestv2.h"
+
+struct TileConfig
+{
+    std::vector<cv::Rect> zones;            // frame coordinates, empty = whole frame
+    bool                  follow_motion = true;   // crop zones down to the focus region
+    int                   min_side      = 192;    // smallest crop side
+    float                 pad           = 0.15f;  // margin around a region, share of its size
+    float                 max_cover     = 0.6f;   // crops above this share of the frame: full frame
+    int                   max_tiles     = 3;
+};
+
+// Picks the crops yoloFastestv2 runs on for one frame. Each zone is cut
+// down to the focus region (motion + boxes still being tracked), padded,
+// grown to at least min_side and merged with the crops it overlaps. When
+// the crops would cost about as much as a full pass (too many, or covering
+// most of the frame) the whole frame is used instead.
+//
+// Not thread-safe; each user thread keeps its own planner.
+class TilePlanner
+{
+public:
+    TilePlanner(int frame_w, int frame_h, const TileConfig& cfg = TileConfig());
+
+    // false when the focus lies outside every zone (nothing to detect);
+    // otherwise tiles holds the crops, empty = run on the whole frame.
+    // An empty focus means "no idea where to look": the zones are used as is.
+    bool plan(const cv::Rect& motion, const std::vector<TargetBox>& tracked,
+              std::vector<cv::Rect>& tiles);
+
+    // with zones configured, drop boxes whose centre lies outside all of them
+    void filter(std::vector<TargetBox>& boxes) const;
+
+    const TileConfig& config() const { return cfg_; }
+
+private:
+    cv::Rect fit(const cv::Rect& region) const;
+
+    int        frame_w_;
+    int        frame_h_;
+    TileConfig cfg_;
+};
+
+#endif // TILE_PLANNER_HPP
@@ -0,0 +1,77 @@
+// det_dump: print the detection messages yolo_cam sends over UDP.
+//
+//   det_dump [port] [--count N]
+//
+// Binds 0.0.0.0:port (default 9001, stop ws_bridge.py first) and prints one
+// JSON line per message. Binary messages (--udp-format binary) are decoded
+// with det_wire and re-encoded as the JSON yolo_cam would have sent; JSON
+// messages are printed as received. Example consumer of the det_wire library.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "det_wire.hpp"
+
+int main(int argc, char** argv)
+{
+    int  port  = 9001;
+    long count = -1;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--count" && i + 1 < argc) count = std::atol(argv[++i]);
+        else port = std::atoi(argv[i]);
+    }
+
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        std::perror("socket");
+        return 1;
+    }
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        std::perror("bind");
+        return 1;
+    }
+
+    std::vector<char> buf(kDetMaxDatagram);
+    DetWirePacket pkt;
+    DetWriter     json(DetWriter::JSON);
+    for (long n = 0; count < 0 || n < count; n++) {
+        ssize_t len = ::recv(fd, buf.data(), buf.size(), 0);
+        if (len < 0) {
+            std::perror("recv");
+            break;
+        }
+        if (len > 0 && buf[0] == '{') {
+            std::fwrite(buf.data(), 1, (size_t)len, stdout);
+            std::fputc('\n', stdout);
+        } else {
+            DetDecodeStatus st = det_wire_decode(buf.data(), (size_t)len, pkt);
+            if (st != DET_OK) {
+                std::fprintf(stderr, "%zd-byte message: %s\n", len, det_decode_status_name(st));
+                continue;
+            }
+            json.begin(pkt.frame_id, pkt.ts_ms / 1000.0, pkt.loop_fps, pkt.det_fps, pkt.person);
+            for (const DetWireBox& b : pkt.boxes)
+                json.add_box(b.cls, b.score, b.x1, b.y1, b.x2, b.y2);
+            json.finish();
+            std::fwrite(json.data(), 1, json.size(), stdout);
+            std::fputc('\n', stdout);
+        }
+        std::fflush(stdout);
+    }
+    ::close(fd);
+    return 0;
+}
@@ -0,0 +1,135 @@
+// perf2csv: binary PerfLogger log -> CSV.
+//
+//   perf2csv perf_log.bin [perf_log.csv] [--events events.csv]
+//
+// The frame CSV has the columns the text logger wrote
+// (frame_id,t_cam,t_pp,t_det_s,t_det_e,t_dec,t_aud,ran_infer), one row per
+// PERF_FRAME_COMMIT in commit order, times in steady_clock seconds and 0
+// for a stamp the frame never reached. Marks, values and spans with other
+// names go to the events CSV (thread,frame_id,kind,name,t,dur_us,value).
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PerfLogger.hpp"
+
+using namespace perf_detail;
+
+struct Row {
+    double t[N_RAN_INFER] = {};
+    int    ran_infer = 0;
+};
+
+int main(int argc, char** argv)
+{
+    std::string in, out, events;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--events" && i + 1 < argc) events = argv[++i];
+        else if (in.empty())  in  = a;
+        else if (out.empty()) out = a;
+    }
+    if (in.empty()) {
+        std::fprintf(stderr, "usage: perf2csv perf_log.bin [perf_log.csv] [--events events.csv]\n");
+        return 2;
+    }
+
+    FILE* f = std::fopen(in.c_str(), "rb");
+    if (!f) {
+        std::perror(in.c_str());
+        return 1;
+    }
+    char head[16];
+    uint32_t ver = 0, size = 0;
+    if (std::fread(head, 1, sizeof(head), f) != sizeof(head) || std::memcmp(head, kMagic, 8) != 0) {
+        std::fprintf(stderr, "%s: not a PerfLogger log\n", in.c_str());
+        return 1;
+    }
+    std::memcpy(&ver, head + 8, 4);
+    std::memcpy(&size, head + 12, 4);
+    if (ver != kVersion || size != sizeof(Record)) {
+        std::fprintf(stderr, "%s: log version %u / record size %u not supported\n",
+                     in.c_str(), ver, size);
+        return 1;
+    }
+
+    FILE* fo = out.empty() ? stdout : std::fopen(out.c_str(), "w");
+    FILE* fe = events.empty() ? nullptr : std::fopen(events.c_str(), "w");
+    if (!fo || (!events.empty() && !fe)) {
+        std::perror("output");
+        return 1;
+    }
+    if (fe)
+        std::fprintf(fe, "thread,frame_id,kind,name,t,dur_us,value\n");
+
+    // Frames are keyed by id and written in commit order at the end: marks
+    // of one frame can come from several threads, whose rings are drained
+    // one after the other.
+    std::vector<std::string>          names;
+    std::unordered_map<int64_t, Row>  rows;
+    std::vector<int64_t>              order;
+    std::unordered_map<int, uint64_t> dropped;
+    size_t                            records = 0;
+
+    Record r;
+    while (std::fread(&r, sizeof(r), 1, f) == 1) {
+        records++;
+        switch (r.type) {
+        case REC_NAME: {
+            char text[25] = {};
+            std::memcpy(text, &r, 24);
+            if (names.size() <= r.name) names.resize(r.name + 1);
+            names[r.name] = text;
+            break;
+        }
+        case REC_COMMIT:
+            order.push_back(r.frame);
+            rows[r.frame];
+            break;
+        case REC_DROPPED:
+            dropped[r.thread] = r.aux;
+            break;
+        case REC_MARK:
+        case REC_VALUE:
+        case REC_SPAN:
+            if (r.type == REC_MARK && r.name < N_RAN_INFER && r.frame >= 0) {
+                rows[r.frame].t[r.name] = r.t_ns * 1e-9;
+            } else if (r.type == REC_VALUE && r.name == N_RAN_INFER && r.frame >= 0) {
+                rows[r.frame].ran_infer = (int)r.aux;
+            } else if (fe) {
+                const char* kind = r.type == REC_MARK ? "mark" : r.type == REC_SPAN ? "span" : "value";
+                const char* name = r.name < names.size() ? names[r.name].c_str() : "?";
+                std::fprintf(fe, "%u,%lld,%s,%s,%.9f,%.3f,%llu\n", (unsigned)r.thread,
+                             (long long)r.frame, kind, name, r.t_ns * 1e-9,
+                             r.type == REC_SPAN ? r.aux * 1e-3 : 0.0,
+                             r.type == REC_VALUE ? (unsigned long long)r.aux : 0ULL);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    std::fclose(f);
+
+    std::fprintf(fo, "frame_id,t_cam,t_pp,t_det_s,t_det_e,t_dec,t_aud,ran_infer\n");
+    for (size_t i = 0; i < order.size(); i++) {
+        const Row& row = rows[order[i]];
+        std::fprintf(fo, "%lld", (long long)order[i]);
+        for (int k = 0; k < N_RAN_INFER; k++) {
+            if (row.t[k] > 0.0) std::fprintf(fo, ",%.9f", row.t[k]);
+            else                std::fprintf(fo, ",0");
+        }
+        std::fprintf(fo, ",%d\n", row.ran_infer);
+    }
+    if (fo != stdout) std::fclose(fo);
+    if (fe) std::fclose(fe);
+
+    uint64_t lost = 0;
+    for (const auto& kv : dropped) lost += kv.second;
+    std::fprintf(stderr, "%zu records, %zu frames, %zu names, %llu dropped\n",
+                 records, order.size(), names.size(), (unsigned long long)lost);
+    return 0;
+}
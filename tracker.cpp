@@ -0,0 +1,251 @@
+#include "tracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// noise relative to box height, as in SORT/DeepSORT
+static const float kStdPos = 1.f / 20.f;
+static const float kStdVel = 1.f / 160.f;
+
+// a prediction is trusted while it drifts less than this share of the box
+static const float kDriftFrac = 0.25f;
+
+static float iou(const TargetBox& a, const TargetBox& b)
+{
+    float iw = (float)(std::min(a.x2, b.x2) - std::max(a.x1, b.x1));
+    float ih = (float)(std::min(a.y2, b.y2) - std::max(a.y1, b.y1));
+    if (iw <= 0.f || ih <= 0.f)
+        return 0.f;
+    float inter = iw * ih;
+    float uni   = a.area() + b.area() - inter;
+    return (uni > 0.f) ? inter / uni : 0.f;
+}
+
+//  KalmanBox 
+void KalmanBox::init(const TargetBox& b)
+{
+    x[0] = 0.5f * (b.x1 + b.x2);
+    x[1] = 0.5f * (b.y1 + b.y2);
+    x[2] = (float)(b.x2 - b.x1);
+    x[3] = (float)(b.y2 - b.y1);
+
+    float h  = std::max(x[3], 1.f);
+    float sp = 2.f * kStdPos * h;
+    float sv = 10.f * kStdVel * h;
+    for (int i = 0; i < 4; i++)
+    {
+        v[i]   = 0.f;
+        p00[i] = sp * sp;
+        p01[i] = 0.f;
+        p11[i] = sv * sv;
+    }
+}
+
+void KalmanBox::predict(float dt)
+{
+    float h  = std::max(x[3], 1.f);
+    float qp = (kStdPos * h) * (kStdPos * h) * dt;
+    float qv = (kStdVel * h) * (kStdVel * h) * dt;
+    for (int i = 0; i < 4; i++)
+    {
+        x[i]  += v[i] * dt;
+        p00[i] += dt * (2.f * p01[i] + dt * p11[i]) + qp;
+        p01[i] += dt * p11[i];
+        p11[i] += qv;
+    }
+    x[2] = std::max(x[2], 1.f);
+    x[3] = std::max(x[3], 1.f);
+}
+
+void KalmanBox::update(const TargetBox& b)
+{
+    const float z[4] = {
+        0.5f * (b.x1 + b.x2),
+        0.5f * (b.y1 + b.y2),
+        (float)(b.x2 - b.x1),
+        (float)(b.y2 - b.y1)
+    };
+    float h = std::max(x[3], 1.f);
+    float r = (kStdPos * h) * (kStdPos * h);
+    for (int i = 0; i < 4; i++)
+    {
+        float s  = p00[i] + r;
+        float k0 = p00[i] / s;
+        float k1 = p01[i] / s;
+        float y  = z[i] - x[i];
+        x[i] += k0 * y;
+        v[i] += k1 * y;
+        p11[i] -= k1 * p01[i];
+        p00[i] *= (1.f - k0);
+        p01[i] *= (1.f - k0);
+    }
+}
+
+void KalmanBox::toBox(TargetBox& b) const
+{
+    b.x1 = (int)(x[0] - 0.5f * x[2]);
+    b.y1 = (int)(x[1] - 0.5f * x[3]);
+    b.x2 = (int)(x[0] + 0.5f * x[2]);
+    b.y2 = (int)(x[1] + 0.5f * x[3]);
+}
+
+float KalmanBox::posSigma() const
+{
+    return std::sqrt(std::max(p00[0], p00[1]));
+}
+
+//  MultiTracker 
+MultiTracker::MultiTracker(float iou_thresh, int min_hits, int max_misses, int max_age)
+    : iou_thresh_(iou_thresh)
+    , min_hits_(min_hits)
+    , max_misses_(max_misses)
+    , max_age_(max_age)
+    , next_id_(1)
+    , churn_(false)
+{
+    tracks_.reserve(32);
+}
+
+void MultiTracker::advance(Track& t, uint64_t frame_id)
+{
+    if (frame_id > t.last_frame)
+    {
+        t.kf.predict((float)(frame_id - t.last_frame));
+        t.last_frame = frame_id;
+    }
+}
+
+void MultiTracker::update(uint64_t frame_id, const std::vector<TargetBox>& boxes)
+{
+    churn_ = false;
+    for (size_t i = 0; i < tracks_.size(); i++)
+        advance(tracks_[i], frame_id);
+
+    det_used_.assign(boxes.size(), 0);
+    trk_used_.assign(tracks_.size(), 0);
+
+    // greedy association, best IoU first (a handful of people per frame)
+    while (true)
+    {
+        float best = iou_thresh_;
+        int   bt = -1, bd = -1;
+        for (size_t t = 0; t < tracks_.size(); t++)
+        {
+            if (trk_used_[t]) continue;
+            TargetBox pred;
+            tracks_[t].kf.toBox(pred);
+            for (size_t d = 0; d < boxes.size(); d++)
+            {
+                if (det_used_[d] || boxes[d].cate != tracks_[t].cate) continue;
+                float ov = iou(pred, boxes[d]);
+                if (ov > best) { best = ov; bt = (int)t; bd = (int)d; }
+            }
+        }
+        if (bt < 0)
+            break;
+
+        Track& t = tracks_[bt];
+        t.kf.update(boxes[bd]);
+        t.score     = boxes[bd].score;
+        t.hits++;
+        t.misses    = 0;
+        t.last_seen = frame_id;
+        trk_used_[bt] = 1;
+        det_used_[bd] = 1;
+    }
+
+    for (size_t t = 0; t < tracks_.size(); t++)
+    {
+        if (!trk_used_[t])
+            tracks_[t].misses++;
+    }
+
+    // retire lost tracks
+    size_t keep = 0;
+    for (size_t t = 0; t < tracks_.size(); t++)
+    {
+        const Track& tr = tracks_[t];
+        bool lost = tr.misses > max_misses_ ||
+                    (int)(frame_id - tr.last_seen) > max_age_;
+        if (lost)
+        {
+            churn_ = true;
+            continue;
+        }
+        tracks_[keep++] = tr;
+    }
+    tracks_.resize(keep);
+
+    // spawn tracks for unmatched detections
+    for (size_t d = 0; d < boxes.size(); d++)
+    {
+        if (det_used_[d]) continue;
+        Track t;
+        t.id         = next_id_++;
+        t.cate       = boxes[d].cate;
+        t.score      = boxes[d].score;
+        t.hits       = 1;
+        t.misses     = 0;
+        t.last_frame = frame_id;
+        t.last_seen  = frame_id;
+        t.kf.init(boxes[d]);
+        tracks_.push_back(t);
+        churn_ = true;
+    }
+}
+
+void MultiTracker::predict(uint64_t frame_id, std::vector<TargetBox>& out)
+{
+    out.clear();
+    for (size_t i = 0; i < tracks_.size(); i++)
+    {
+        Track& t = tracks_[i];
+        advance(t, frame_id);
+        if (t.hits < min_hits_ || (int)(frame_id - t.last_seen) > max_age_)
+            continue;
+
+        TargetBox b;
+        t.kf.toBox(b);
+        b.cate  = t.cate;
+        b.score = t.score;
+        out.push_back(b);
+    }
+}
+
+int MultiTracker::suggest_interval(int min_every, int max_every) const
+{
+    if (tracks_.empty())
+        return max_every;
+    if (churn_)
+        return min_every;
+
+    float frames = (float)max_every;
+    for (size_t i = 0; i < tracks_.size(); i++)
+    {
+        const Track& t = tracks_[i];
+        if (t.hits < min_hits_ || t.misses > 0)
+            return min_every;
+
+        float budget = kDriftFrac * std::min(t.kf.x[2], t.kf.x[3]);
+        float sigma  = t.kf.posSigma();
+        if (sigma >= budget)
+            return min_every;
+
+        float speed = std::sqrt(t.kf.v[0] * t.kf.v[0] + t.kf.v[1] * t.kf.v[1]);
+        frames = std::min(frames, (budget - sigma) / std::max(speed, 0.1f));
+    }
+    return std::max(min_every, std::min(max_every, (int)frames));
+}
+
+//  DetectScheduler 
+bool DetectScheduler::should_detect()
+{
+    since_++;
+    if (force_.exchange(false, std::memory_order_relaxed) ||
+        since_ >= interval_.load(std::memory_order_relaxed))
+    {
+        since_ = 0;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,97 @@
+#ifndef TRACKER_HPP
+#define TRACKER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "yolo-fastestv2.h"
+
+// Constant-velocity Kalman filter on (cx, cy, w, h), one independent
+// (position, velocity) filter per coordinate. Time unit is one camera frame.
+struct KalmanBox
+{
+    float x[4];      // cx, cy, w, h
+    float v[4];      // per-frame velocity
+    float p00[4];    // covariance per coordinate: var(x), cov(x,v), var(v)
+    float p01[4];
+    float p11[4];
+
+    void init(const TargetBox& b);
+    void predict(float dt);
+    void update(const TargetBox& b);
+    void toBox(TargetBox& b) const;
+    float posSigma() const;   // largest position std dev of cx/cy
+};
+
+struct Track
+{
+    int       id;
+    int       cate;
+    float     score;        // score of the last matched detection
+    int       hits;         // matched detections
+    int       misses;       // consecutive detection frames without a match
+    uint64_t  last_frame;   // frame the filter was last advanced to
+    uint64_t  last_seen;    // frame of the last matched detection
+    KalmanBox kf;
+};
+
+// IoU-associated multi-object tracker. Runs on the detect stage, fed in
+// frame order: update() on frames that ran inference, predict() on the
+// ones that did not.
+class MultiTracker
+{
+public:
+    MultiTracker(float iou_thresh = 0.3f, int min_hits = 2,
+                 int max_misses = 2, int max_age = 30);
+
+    // associate detections, spawn/retire tracks; boxes are left untouched
+    void update(uint64_t frame_id, const std::vector<TargetBox>& boxes);
+    // advance every track to frame_id, out = confirmed tracks' boxes
+    void predict(uint64_t frame_id, std::vector<TargetBox>& out);
+
+    // how many frames the next inference can wait: min_every while tracks
+    // are new, lost or uncertain, up to max_every when the scene is stable
+    int suggest_interval(int min_every, int max_every) const;
+
+    const std::vector<Track>& tracks() const { return tracks_; }
+
+private:
+    void advance(Track& t, uint64_t frame_id);
+
+    float iou_thresh_;
+    int   min_hits_;
+    int   max_misses_;
+    int   max_age_;
+
+    std::vector<Track> tracks_;
+    int                next_id_;
+    bool               churn_;   // last update created or lost a track
+
+    // association scratch
+    std::vector<char>  det_used_;
+    std::vector<char>  trk_used_;
+};
+
+// Decides per frame whether the dispatcher runs inference. The interval
+// is set from the tracker on the results side; force() asks for the next
+// frame to be detected regardless.
+class DetectScheduler
+{
+public:
+    explicit DetectScheduler(int interval = 1) : interval_(interval) {}
+
+    void set_interval(int n) { interval_.store(n < 1 ? 1 : n, std::memory_order_relaxed); }
+    int  interval() const { return interval_.load(std::memory_order_relaxed); }
+    void force() { force_.store(true, std::memory_order_relaxed); }
+
+    // dispatcher thread only
+    bool should_detect();
+
+private:
+    std::atomic<int>  interval_;
+    std::atomic<bool> force_{true};
+    int               since_ = 0;
+};
+
+#endif // TRACKER_HPP
@@ -1,39 +1,168 @@
 #include "udp_sender.hpp"
 
-#include <cstring>
 #include <arpa/inet.h>
+#include <netdb.h>
 #include <sys/socket.h>
 #include <unistd.h>
 
-struct sockaddr_in;
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
-UdpSender::UdpSender(const std::string& ip, uint16_t port)
+UdpSender::UdpSender()
 {
-    sock_ = ::socket(AF_INET, SOCK_DGRAM, 0);
-    addr_ = new sockaddr_in();
-    std::memset(addr_, 0, sizeof(sockaddr_in));
-    addr_->sin_family = AF_INET;
-    addr_->sin_port = htons(port);
-    ::inet_pton(AF_INET, ip.c_str(), &(addr_->sin_addr));
+    batch_.reserve(kMaxBatchBytes);
+    pending_.reserve(kMaxBatchMsgs);
 }
 
 UdpSender::~UdpSender()
 {
-    if (sock_ >= 0) ::close(sock_);
-    delete addr_;
+    if (fd_ >= 0) ::close(fd_);
+}
+
+bool UdpSender::add_destination(const std::string& spec)
+{
+    size_t colon = spec.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == spec.size())
+        return false;
+    const std::string host = spec.substr(0, colon);
+    const int port = std::atoi(spec.c_str() + colon + 1);
+    if (port <= 0 || port > 65535)
+        return false;
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* res = nullptr;
+    if (::getaddrinfo(host.c_str(), nullptr, &hints, &res) != 0 || !res)
+        return false;
+
+    sockaddr_in addr;
+    std::memcpy(&addr, res->ai_addr, sizeof(addr));
+    ::freeaddrinfo(res);
+    addr.sin_port = htons((uint16_t)port);
+    dests_.push_back(addr);
+    return true;
+}
+
+std::string UdpSender::describe() const
+{
+    std::string s;
+    for (size_t i = 0; i < dests_.size(); i++) {
+        char ip[INET_ADDRSTRLEN];
+        ::inet_ntop(AF_INET, &dests_[i].sin_addr, ip, sizeof(ip));
+        if (i) s += ',';
+        s += ip;
+        s += ':';
+        s += std::to_string(ntohs(dests_[i].sin_port));
+    }
+    return s;
+}
+
+bool UdpSender::open(int sndbuf, int mcast_ttl)
+{
+    fd_ = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        std::perror("socket");
+        return false;
+    }
+    if (sndbuf > 0 && ::setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)) != 0)
+        std::perror("SO_SNDBUF");
+
+    bool multicast = false;
+    for (const sockaddr_in& d : dests_)
+        multicast |= IN_MULTICAST(ntohl(d.sin_addr.s_addr));
+    if (multicast) {
+        unsigned char ttl  = (unsigned char)mcast_ttl;
+        unsigned char loop = 1;   // subscribers on this host (ws_bridge.py) still get it
+        ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        ::setsockopt(fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    }
+    return true;
+}
+
+bool UdpSender::queue(const char* data, size_t len)
+{
+    if (fd_ < 0 || dests_.empty())
+        return false;
+    if (pending_.size() == kMaxBatchMsgs || batch_.size() + len > kMaxBatchBytes)
+        flush();
+    if (len > kMaxBatchBytes)
+        return false;
+
+    Pending p;
+    p.off = batch_.size();
+    p.len = len;
+    batch_.insert(batch_.end(), data, data + len);
+    pending_.push_back(p);
+    return true;
 }
 
-bool UdpSender::send_text(const std::string& s)
+int UdpSender::flush()
 {
-    return send_bytes(reinterpret_cast<const uint8_t*>(s.data()), s.size());
+    if (pending_.empty())
+        return 0;
+
+    // one mmsghdr per (message, destination), handed over kVlen at a time
+    static const size_t kVlen = 64;
+    mmsghdr msgs[kVlen];
+    iovec   iovs[kVlen];
+
+    const size_t total = pending_.size() * dests_.size();
+    size_t next = 0;   // flat index: message * destinations + destination
+    int    sent = 0;
+    while (next < total) {
+        const size_t n = total - next < kVlen ? total - next : kVlen;
+        for (size_t k = 0; k < n; k++) {
+            const Pending& p = pending_[(next + k) / dests_.size()];
+            iovs[k].iov_base = &batch_[p.off];
+            iovs[k].iov_len  = p.len;
+            std::memset(&msgs[k], 0, sizeof(msgs[k]));
+            msgs[k].msg_hdr.msg_name    = &dests_[(next + k) % dests_.size()];
+            msgs[k].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+            msgs[k].msg_hdr.msg_iov     = &iovs[k];
+            msgs[k].msg_hdr.msg_iovlen  = 1;
+        }
+
+        int r = ::sendmmsg(fd_, msgs, (unsigned)n, MSG_DONTWAIT);
+        syscalls_.fetch_add(1, std::memory_order_relaxed);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // buffer full: the rest would fail the same way, drop them
+                eagain_.fetch_add(total - next, std::memory_order_relaxed);
+                break;
+            }
+            // this datagram failed (e.g. ECONNREFUSED from an earlier ICMP); skip it
+            errors_.fetch_add(1, std::memory_order_relaxed);
+            next++;
+            continue;
+        }
+
+        uint64_t bytes = 0;
+        for (int k = 0; k < r; k++)
+            bytes += msgs[k].msg_len;
+        datagrams_.fetch_add((uint64_t)r, std::memory_order_relaxed);
+        bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        sent += r;
+        next += (size_t)r;
+    }
+
+    batch_.clear();
+    pending_.clear();
+    return sent;
 }
 
-bool UdpSender::send_bytes(const uint8_t* data, size_t len)
+UdpSenderStats UdpSender::stats() const
 {
-    if (sock_ < 0) return false;
-    // UDP datagram max ~65KB -> 352x352 JPEG (quality 60-80) thường < 60KB
-    ssize_t sent = ::sendto(sock_, data, len, 0,
-                            reinterpret_cast<sockaddr*>(addr_),
-                            sizeof(sockaddr_in));
-    return (sent == (ssize_t)len);
-}
\ No newline at end of file
+    UdpSenderStats s;
+    s.datagrams = datagrams_.load(std::memory_order_relaxed);
+    s.bytes     = bytes_.load(std::memory_order_relaxed);
+    s.syscalls  = syscalls_.load(std::memory_order_relaxed);
+    s.eagain    = eagain_.load(std::memory_order_relaxed);
+    s.errors    = errors_.load(std::memory_order_relaxed);
+    return s;
+}
@@ -1,16 +1,71 @@
-#pragma once
-#include <string>
+#ifndef UDP_SENDER_HPP
+#define UDP_SENDER_HPP
+
+#include <netinet/in.h>
+
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
+#include <string>
+#include <vector>
+
+// Counters, readable from any thread while the sender runs.
+struct UdpSenderStats
+{
+    uint64_t datagrams = 0;   // delivered to the kernel, one per destination
+    uint64_t bytes     = 0;
+    uint64_t syscalls  = 0;   // sendmmsg calls
+    uint64_t eagain    = 0;   // datagrams dropped because the socket buffer was full
+    uint64_t errors    = 0;   // datagrams dropped on any other error
+};
 
-class UdpSender {
+// One UDP socket publishing every message to a list of destinations,
+// unicast or multicast. The socket is non-blocking: a full send buffer
+// drops the datagram and counts it, the caller never waits.
+//
+// queue() copies a message into a batch; flush() hands the whole batch
+// (every message x every destination) to the kernel with as few sendmmsg
+// calls as possible. send() is queue() + flush(). One thread sends.
+class UdpSender
+{
 public:
-    UdpSender(const std::string& ip, uint16_t port);
+    static const size_t kMaxBatchBytes = 256 * 1024;   // queued payload before queue() flushes
+    static const size_t kMaxBatchMsgs  = 64;
+
+    UdpSender();
     ~UdpSender();
 
-    bool send_text(const std::string& s);
-    bool send_bytes(const uint8_t* data, size_t len);
+    // "host:port"; 224.0.0.0/4 joins as a multicast destination. Before open().
+    bool add_destination(const std::string& spec);
+    size_t destinations() const { return dests_.size(); }
+    std::string describe() const;   // "127.0.0.1:9001,239.0.0.1:9001"
+
+    // sndbuf: SO_SNDBUF bytes (0 = system default); ttl for multicast, 1 = local subnet
+    bool open(int sndbuf = 0, int mcast_ttl = 1);
+
+    bool queue(const char* data, size_t len);
+    int  flush();   // datagrams sent
+    bool send(const char* data, size_t len) { return queue(data, len) && flush() > 0; }
+    bool send_text(const std::string& s)    { return send(s.data(), s.size()); }
+
+    UdpSenderStats stats() const;
 
 private:
-    int sock_;
-    struct sockaddr_in* addr_;
-};
\ No newline at end of file
+    struct Pending {
+        size_t off;
+        size_t len;
+    };
+
+    int                      fd_ = -1;
+    std::vector<sockaddr_in> dests_;
+    std::vector<char>        batch_;     // queued payloads, back to back
+    std::vector<Pending>     pending_;
+
+    std::atomic<uint64_t> datagrams_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> syscalls_{0};
+    std::atomic<uint64_t> eagain_{0};
+    std::atomic<uint64_t> errors_{0};
+};
+
+#endif // UDP_SENDER_HPP
@@ -16,6 +16,7 @@ with st.sidebar:
     st.markdown("## Connection")
 
     pi_ip = st.text_input("Pi IP", value="172.20.10.2")
+    transport = st.radio("Detections", ["SSE (direct)", "WebSocket (ws_bridge.py)"], index=0)
     ws_port = st.number_input("WS Port", min_value=1, max_value=65535, value=8765, step=1)
     mjpeg_port = st.number_input("MJPEG Port", min_value=1, max_value=65535, value=8080, step=1)
 
@@ -26,6 +27,9 @@ with st.sidebar:
     show_beep = st.toggle("Beep on PERSON", value=True)
 
 ws_url = f"ws://{pi_ip}:{ws_port}"
+events_url = f"http://{pi_ip}:{mjpeg_port}/events"
+use_sse = transport.startswith("SSE")
+det_label, det_url = ("Events", events_url) if use_sse else ("WS", ws_url)
 mjpeg_url = f"http://{pi_ip}:{mjpeg_port}/stream.mjpg"
 snapshot_url = f"http://{pi_ip}:{mjpeg_port}/snapshot.jpg"
 
@@ -251,7 +255,7 @@ html = f"""
     <div class="small" style="margin-top:10px;">
       MJPEG: <span style="color:#fff">{mjpeg_url}</span> &nbsp;|&nbsp;
       Snapshot: <span style="color:#fff">{snapshot_url}</span> &nbsp;|&nbsp;
-      WS: <span style="color:#fff">{ws_url}</span>
+      {det_label}: <span style="color:#fff">{det_url}</span>
     </div>
   </div>
 
@@ -284,6 +288,8 @@ html = f"""
 
 <script>
   const WS_URL = "{ws_url}";
+  const EVENTS_URL = "{events_url}";
+  const USE_SSE = {str(use_sse).lower()};   // EventSource on yolo_cam /events, no bridge process
   const OVERLAY_ON = {str(show_overlay).lower()};
   const BEEP_ON = {str(show_beep).lower()};
 
@@ -502,10 +508,12 @@ html = f"""
 
   function connectWS(force=false) {{
     if (!running) return;
-    if (ws && ws.readyState === WebSocket.OPEN && !force) return;
+    if (ws && ws.readyState === 1 && !force) return;   // OPEN for both
+    if (ws) {{ try {{ ws.close(); }} catch(e){{}} ws=null; }}
 
     try {{
-      ws = new WebSocket(WS_URL);
+      // same JSON messages either way; EventSource reconnects by itself (Last-Event-ID)
+      ws = USE_SSE ? new EventSource(EVENTS_URL) : new WebSocket(WS_URL);
 
       ws.onopen = () => {{
         badge.textContent = "WS: connected | LoopFPS:0.0 DetFPS:0.0 | ALERT:NO";
@@ -575,7 +583,8 @@ html = f"""
       }};
 
       ws.onerror = () => {{
-        // will trigger close too
+        // WebSocket: onclose follows; EventSource: retries on its own
+        if (USE_SSE) badge.textContent = "WS: reconnecting... | LoopFPS:0.0 DetFPS:0.0 | ALERT:NO";
       }};
 
     }} catch(e) {{
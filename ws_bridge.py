@@ -1,4 +1,4 @@
-import asyncio, json, socket
+import asyncio, json, socket, struct
 import websockets
 
 UDP_IP   = "127.0.0.1"
@@ -9,6 +9,25 @@ WS_PORT  = 8765
 
 clients = set()
 
+# binary detection message, see det_wire.hpp
+DET_HEADER = struct.Struct("<2sBBHHQQff")
+DET_BOX    = struct.Struct("<5fHH")
+
+def decode_binary(data):
+    if len(data) < DET_HEADER.size:
+        return None
+    magic, ver, flags, hsize, count, frame_id, ts_ms, loop_fps, det_fps = DET_HEADER.unpack_from(data)
+    if ver != 1 or hsize < DET_HEADER.size or len(data) < hsize + count * DET_BOX.size:
+        return None
+    dets = []
+    for i in range(count):
+        x1, y1, x2, y2, score, cls, _ = DET_BOX.unpack_from(data, hsize + i * DET_BOX.size)
+        dets.append('{"cls":"%s","conf":%.3f,"bbox":[%.3f,%.3f,%.3f,%.3f]}'
+                    % ("person" if cls == 0 else "other", score, x1, y1, x2, y2))
+    return ('{"ts":%.3f,"frame_id":%d,"loop_fps":%.2f,"det_fps":%.2f,"person":%s,"detections":[%s]}'
+            % (ts_ms / 1000.0, frame_id, loop_fps, det_fps,
+               "true" if flags & 1 else "false", ",".join(dets)))
+
 def make_udp_socket():
     s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
     s.bind((UDP_IP, UDP_PORT))
@@ -20,14 +39,19 @@ async def udp_reader(sock):
     while True:
         try:
             data, _ = await loop.sock_recvfrom(sock, 65535)
-            # data là bytes JSON
-            msg = data.decode("utf-8", errors="ignore").strip()
-            # validate JSON nhẹ
-            try:
-                obj = json.loads(msg)
-                payload = json.dumps(obj)
-            except:
-                continue
+            if data[:2] == b"YD":
+                # binary (yolo_cam --udp-format binary) -> same JSON as the text format
+                payload = decode_binary(data)
+                if payload is None:
+                    continue
+            else:
+                # data là bytes JSON, forwarded as sent
+                payload = data.decode("utf-8", errors="ignore").strip()
+                # validate JSON nhẹ
+                try:
+                    json.loads(payload)
+                except:
+                    continue
 
             # broadcast tới mọi client
             dead = []
@@ -4,6 +4,17 @@
 #include <cmath>
 #include <cstdio>
 #include <cassert>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
  
 //  Constructor 
 yoloFastestv2::yoloFastestv2()
@@ -15,6 +26,12 @@ yoloFastestv2::yoloFastestv2()
     nmsThresh   = 0.25f;
     inputWidth  = 352;
     inputHeight = 352;
+    ppSrcW      = 0;
+    ppSrcH      = 0;
+    ppDstW      = 0;
+    ppDstH      = 0;
+
+    net = std::make_shared<ncnn::Net>();
  
     std::vector<float> bias{
         12.64f, 19.39f,
@@ -25,17 +42,26 @@ yoloFastestv2::yoloFastestv2()
         279.92f, 258.87f
     };
     anchor.assign(bias.begin(), bias.end());
+
+    // worst case: every anchor of both heads (22x22 + 11x11) passes
+    candBoxes.reserve(numAnchor * (22 * 22 + 11 * 11));
+    tileBoxes.reserve(candBoxes.capacity());
+
+    NmsConfig nmsCfg;
+    nmsCfg.iou_thresh = nmsThresh;
+    nms.set_config(nmsCfg);
 }
 
 yoloFastestv2::~yoloFastestv2()
 {
+    stopAsync();
 }
  
 //  init() – set NCNN option
 
 int yoloFastestv2::init(bool use_vulkan_compute)
 {
-    ncnn::Option& opt = net.opt;
+    ncnn::Option& opt = net->opt;
 
     opt.num_threads              = numThreads;
     opt.use_winograd_convolution = true;
@@ -49,117 +75,371 @@ int yoloFastestv2::init(bool use_vulkan_compute)
     opt.use_int8_arithmetic      = true;
     opt.use_packing_layout       = true;
 
+    // options are copied into the extractor, so rebuild it if already loaded
+    if (extractor)
+        createExtractor();
+
     return 0;
 }
+
+void yoloFastestv2::setNumThreads(int threads)
+{
+    numThreads = std::max(threads, 1);
+    if (extractor)
+        createExtractor();
+}
  
 //  load model
 
 int yoloFastestv2::loadModel(const char* paramPath, const char* binPath)
 {
-    if (net.load_param(paramPath) != 0)
+    if (net->load_param(paramPath) != 0)
     {
         std::fprintf(stderr, "load_param failed: %s\n", paramPath);
         return -1;
     }
-    if (net.load_model(binPath) != 0)
+    if (net->load_model(binPath) != 0)
     {
         std::fprintf(stderr, "load_model failed: %s\n", binPath);
         return -1;
     }
 
+    createExtractor();
+
     std::printf("NCNN model init success...\n");
     return 0;
 }
+
+int yoloFastestv2::shareModel(const yoloFastestv2& other)
+{
+    if (!other.extractor)
+        return -1;
+
+    net = other.net;
+    createExtractor();
+    return 0;
+}
+
+// Extractor settings are per detector: thread budget and the detector's
+// own pools (the shared Net's options stay allocator-free). extractorProto
+// is never run; forward() resets the working extractor by assigning from
+// it, which swaps in empty blobs (releasing last run's into the pools)
+// without reallocating the blob table.
+void yoloFastestv2::createExtractor()
+{
+    extractorProto.reset(new ncnn::Extractor(net->create_extractor()));
+    extractorProto->set_num_threads(numThreads);
+    extractorProto->set_blob_allocator(&blobPool);
+    extractorProto->set_workspace_allocator(&workspacePool);
+
+    extractor.reset(new ncnn::Extractor(*extractorProto));
+}
  
-//  IoU helper 
-static float intersection_area(const TargetBox& a, const TargetBox& b)
+//  preprocess: fused bilinear resize + normalize 
+
+void yoloFastestv2::buildResizeTables(int srcW, int srcH, int dstW, int dstH)
 {
-    if (a.x1 > b.x2 || a.x2 < b.x1 || a.y1 > b.y2 || a.y2 < b.y1)
-        return 0.f;
+    ppSrcW = srcW;
+    ppSrcH = srcH;
+    ppDstW = dstW;
+    ppDstH = dstH;
+
+    ppXofs.resize(dstW);
+    ppAlpha.resize(dstW);
+    const float sx = (float)srcW / (float)dstW;
+    for (int dx = 0; dx < dstW; dx++)
+    {
+        float fx = (dx + 0.5f) * sx - 0.5f;
+        int   x  = (int)std::floor(fx);
+        float a  = fx - (float)x;
+        if (x < 0)         { x = 0;        a = 0.f; }
+        if (x >= srcW - 1) { x = srcW - 2; a = 1.f; }
+        ppXofs[dx]  = x * 3;
+        ppAlpha[dx] = a;
+    }
 
-    float inter_width  = (float)(std::min(a.x2, b.x2) - std::max(a.x1, b.x1));
-    float inter_height = (float)(std::min(a.y2, b.y2) - std::max(a.y1, b.y1));
+    ppYofs.resize(dstH);
+    ppBeta.resize(dstH);
+    const float sy = (float)srcH / (float)dstH;
+    for (int dy = 0; dy < dstH; dy++)
+    {
+        float fy = (dy + 0.5f) * sy - 0.5f;
+        int   y  = (int)std::floor(fy);
+        float b  = fy - (float)y;
+        if (y < 0)         { y = 0;        b = 0.f; }
+        if (y >= srcH - 1) { y = srcH - 2; b = 1.f; }
+        ppYofs[dy] = y;
+        ppBeta[dy] = b;
+    }
+
+    ppRow.resize((size_t)srcW * 3);
+}
+
+// dst[i] = r0[i] * w0 + r1[i] * w1   (u8 -> float)
+static void blendRows(const unsigned char* r0, const unsigned char* r1,
+                      float w0, float w1, float* dst, int n)
+{
+    int i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    const float32x4_t v0 = vdupq_n_f32(w0);
+    const float32x4_t v1 = vdupq_n_f32(w1);
+    for (; i + 8 <= n; i += 8)
+    {
+        uint16x8_t a = vmovl_u8(vld1_u8(r0 + i));
+        uint16x8_t b = vmovl_u8(vld1_u8(r1 + i));
+        float32x4_t alo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(a)));
+        float32x4_t ahi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(a)));
+        float32x4_t blo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(b)));
+        float32x4_t bhi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(b)));
+        vst1q_f32(dst + i,     vmlaq_f32(vmulq_f32(alo, v0), blo, v1));
+        vst1q_f32(dst + i + 4, vmlaq_f32(vmulq_f32(ahi, v0), bhi, v1));
+    }
+#elif defined(__AVX2__)
+    const __m256 v0 = _mm256_set1_ps(w0);
+    const __m256 v1 = _mm256_set1_ps(w1);
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256 a = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i*)(r0 + i))));
+        __m256 b = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i*)(r1 + i))));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_mul_ps(a, v0),
+                                                _mm256_mul_ps(b, v1)));
+    }
+#elif defined(__SSE2__)
+    const __m128  v0 = _mm_set1_ps(w0);
+    const __m128  v1 = _mm_set1_ps(w1);
+    const __m128i z  = _mm_setzero_si128();
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i a16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(r0 + i)), z);
+        __m128i b16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(r1 + i)), z);
+        __m128 alo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(a16, z));
+        __m128 ahi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(a16, z));
+        __m128 blo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(b16, z));
+        __m128 bhi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(b16, z));
+        _mm_storeu_ps(dst + i,     _mm_add_ps(_mm_mul_ps(alo, v0), _mm_mul_ps(blo, v1)));
+        _mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(ahi, v0), _mm_mul_ps(bhi, v1)));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] = r0[i] * w0 + r1[i] * w1;
+}
 
-    return inter_width * inter_height;
+int yoloFastestv2::preprocess(const cv::Mat& srcImg, ncnn::Mat& inputImg)
+{
+    return preprocessTo(srcImg, inputWidth, inputHeight, inputImg);
 }
 
-static bool scoreSort(const TargetBox& a, const TargetBox& b)
+// srcImg may be a ROI header: rows are addressed through ptr(), not data
+int yoloFastestv2::preprocessTo(const cv::Mat& srcImg, int dstW, int dstH,
+                                ncnn::Mat& inputImg)
 {
-    return (a.score > b.score);
+    if (srcImg.empty() || srcImg.type() != CV_8UC3 ||
+        srcImg.cols < 2 || srcImg.rows < 2)
+        return -1;
+
+    if (srcImg.cols != ppSrcW || srcImg.rows != ppSrcH ||
+        dstW != ppDstW || dstH != ppDstH)
+        buildResizeTables(srcImg.cols, srcImg.rows, dstW, dstH);
+
+    inputImg.create(dstW, dstH, 3, 4u);
+
+    float* planeB = inputImg.channel(0);
+    float* planeG = inputImg.channel(1);
+    float* planeR = inputImg.channel(2);
+
+    const int   rowLen = ppSrcW * 3;
+    const float norm   = 1.f / 255.f;
+    float*      row    = ppRow.data();
+
+    for (int dy = 0; dy < dstH; dy++)
+    {
+        // vertical pass on the whole interleaved row (SIMD), normalize folded in
+        const int   y = ppYofs[dy];
+        const float b = ppBeta[dy];
+        blendRows(srcImg.ptr<unsigned char>(y), srcImg.ptr<unsigned char>(y + 1),
+                  (1.f - b) * norm, b * norm, row, rowLen);
+
+        // horizontal pass, deinterleave into planes
+        float* outB = planeB + dy * dstW;
+        float* outG = planeG + dy * dstW;
+        float* outR = planeR + dy * dstW;
+        for (int dx = 0; dx < dstW; dx++)
+        {
+            const float* p = row + ppXofs[dx];
+            const float  a = ppAlpha[dx];
+            outB[dx] = p[0] + (p[3] - p[0]) * a;
+            outG[dx] = p[1] + (p[4] - p[1]) * a;
+            outR[dx] = p[2] + (p[5] - p[2]) * a;
+        }
+    }
+    return 0;
 }
  
 //  NMS 
 int yoloFastestv2::nmsHandle(std::vector<TargetBox>& tmpBoxes,
                              std::vector<TargetBox>& dstBoxes)
 {
-    dstBoxes.clear();
-    if (tmpBoxes.empty())
-        return 0;
+    return nms.run(tmpBoxes, dstBoxes);
+}
+
+void yoloFastestv2::setNmsConfig(const NmsConfig& cfg)
+{
+    nmsThresh = cfg.iou_thresh;
+    nms.set_config(cfg);
+}
+ 
+//  max class score (SIMD) 
+// SIMD max over the class scores of one cell (shared by all anchors).
+// Starts from 0 like the scalar argmax, so a cell of non-positive
+// scores yields 0.
+static float maxClassScore(const float* v, int n)
+{
+    int   i = 0;
+    float m = 0.f;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    float32x4_t vm = vdupq_n_f32(0.f);
+    for (; i + 4 <= n; i += 4)
+        vm = vmaxq_f32(vm, vld1q_f32(v + i));
+#if defined(__aarch64__)
+    m = vmaxvq_f32(vm);
+#else
+    float32x2_t h = vpmax_f32(vget_low_f32(vm), vget_high_f32(vm));
+    h = vpmax_f32(h, h);
+    m = vget_lane_f32(h, 0);
+#endif
+#elif defined(__AVX2__)
+    __m256 vm = _mm256_setzero_ps();
+    for (; i + 8 <= n; i += 8)
+        vm = _mm256_max_ps(vm, _mm256_loadu_ps(v + i));
+    __m128 h = _mm_max_ps(_mm256_castps256_ps128(vm), _mm256_extractf128_ps(vm, 1));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_max_ss(h, _mm_shuffle_ps(h, h, 1));
+    m = _mm_cvtss_f32(h);
+#elif defined(__SSE2__)
+    __m128 h = _mm_setzero_ps();
+    for (; i + 4 <= n; i += 4)
+        h = _mm_max_ps(h, _mm_loadu_ps(v + i));
+    h = _mm_max_ps(h, _mm_movehl_ps(h, h));
+    h = _mm_max_ss(h, _mm_shuffle_ps(h, h, 1));
+    m = _mm_cvtss_f32(h);
+#endif
+    for (; i < n; i++)
+        if (v[i] > m) m = v[i];
+    return m;
+}
 
-    std::sort(tmpBoxes.begin(), tmpBoxes.end(), scoreSort);
+//  class sets 
+// A class set gives decode two things per cell: an upper bound of the
+// class scores it accepts (for gating) and, for an anchor that passes,
+// the first accepted class reaching the best score.
+namespace {
 
-    std::vector<int> picked;
-    picked.reserve(tmpBoxes.size());
+struct AllClasses
+{
+    int num;
 
-    for (size_t i = 0; i < tmpBoxes.size(); i++)
+    float cellMax(const float* cls) const { return maxClassScore(cls, num); }
+    int pick(const float* cls, float obj, float best) const
     {
-        int keep = 1;
-        for (size_t j = 0; j < picked.size(); j++)
-        {
-            float inter_area = intersection_area(tmpBoxes[i], tmpBoxes[picked[j]]);
-            float union_area = tmpBoxes[i].area() + tmpBoxes[picked[j]].area() - inter_area;
-            if (union_area <= 0.f)
-                continue;
-            float IoU = inter_area / union_area;
+        for (int i = 0; i < num; i++)
+            if (cls[i] * obj == best) return i;
+        return -1;
+    }
+};
 
-            if (IoU > nmsThresh && tmpBoxes[i].cate == tmpBoxes[picked[j]].cate)
-            {
-                keep = 0;
-                break;
-            }
-        }
-        if (keep)
-            picked.push_back((int)i);
+// person-only fast path: a single class channel per cell
+struct OneClass
+{
+    int id;
+
+    float cellMax(const float* cls) const { return std::max(cls[id], 0.f); }
+    int pick(const float*, float, float) const { return id; }
+};
+
+struct ClassList
+{
+    const std::vector<int>* ids;
+
+    float cellMax(const float* cls) const
+    {
+        float m = 0.f;
+        for (size_t i = 0; i < ids->size(); i++)
+            m = std::max(m, cls[(*ids)[i]]);
+        return m;
+    }
+    int pick(const float* cls, float obj, float best) const
+    {
+        for (size_t i = 0; i < ids->size(); i++)
+            if (cls[(*ids)[i]] * obj == best) return (*ids)[i];
+        return -1;
     }
+};
 
-    dstBoxes.reserve(picked.size());
-    for (size_t i = 0; i < picked.size(); i++)
-        dstBoxes.push_back(tmpBoxes[picked[i]]);
+} // namespace
 
-    return 0;
-}
- 
-//  getCategory() 
+// Class scores are softmax/sigmoid outputs (<= 1), so cls * obj <= obj and
+// an anchor whose objectness is not above thresh can never pass. For the
+// survivors, max(cls * obj) == max(cls) * obj because scaling by obj > 0 is
+// monotonic; the category is the first class reaching that product, which
+// matches the old scalar argmax exactly.
+template <class ClassSet>
 int yoloFastestv2::getCategory(const float* values, int index,
-                               int& category, float& score)
+                               const ClassSet& classes, float cellMax,
+                               float thresh, int& category, float& score)
 {
+    category = -1;
+    score    = 0.f;
+
     float objScore = values[4 * numAnchor + index];
-    float tmp      = 0.f;
-    category       = -1;
-    score          = 0.f;
+    if (objScore <= thresh || objScore <= 0.f)
+        return 0;
 
-    int base = 4 * numAnchor + numAnchor;
-    for (int i = 0; i < numCategory; i++)
-    {
-        float clsScore = values[base + i] * objScore;
-        if (clsScore > tmp)
-        {
-            tmp      = clsScore;
-            score    = clsScore;
-            category = i;
-        }
-    }
+    float best = cellMax * objScore;
+    if (best <= thresh || best <= 0.f)
+        return 0;
+
+    category = classes.pick(values + 5 * numAnchor, objScore, best);
+    score    = best;
     return 0;
 }
  
 //  post-process feature maps 
 
 int yoloFastestv2::predHandle(const ncnn::Mat* out,
-                              std::vector<TargetBox>& dstBoxes,
+                              std::vector<TargetBox>& candidates,
                               float scaleW, float scaleH,
-                              float thresh)
+                              float thresh,
+                              const std::vector<int>& classes)
+{
+    if (classes.empty())
+    {
+        AllClasses set{numCategory};
+        return decodeHeads(out, candidates, scaleW, scaleH, thresh, set);
+    }
+    for (size_t i = 0; i < classes.size(); i++)
+    {
+        if (classes[i] < 0 || classes[i] >= numCategory)
+            return -1;
+    }
+    if (classes.size() == 1)
+    {
+        OneClass set{classes[0]};
+        return decodeHeads(out, candidates, scaleW, scaleH, thresh, set);
+    }
+    ClassList set{&classes};
+    return decodeHeads(out, candidates, scaleW, scaleH, thresh, set);
+}
+
+template <class ClassSet>
+int yoloFastestv2::decodeHeads(const ncnn::Mat* out,
+                               std::vector<TargetBox>& candidates,
+                               float scaleW, float scaleH,
+                               float thresh,
+                               const ClassSet& classes)
 {
-    std::vector<TargetBox> tmpBoxes;
+    candidates.clear();
 
     for (int i = 0; i < numOutput; i++)
     {
@@ -169,31 +449,41 @@ int yoloFastestv2::predHandle(const ncnn::Mat* out,
         int outW = feat.h;
         int outC = feat.w;
 
-        assert(inputHeight / outH == inputWidth / outW);
-        int stride = inputHeight / outH;
+        // head strides are fixed by the network (16, 32), whatever the input size
+        const int stride = 16 << i;
+
+        const float* anc = &anchor[i * numAnchor * 2];
 
         for (int h = 0; h < outH; h++)
         {
             const float* values = feat.channel(h);
-            for (int w = 0; w < outW; w++)
+            for (int w = 0; w < outW; w++, values += outC)
             {
+                // cheap objectness reject before touching the class scores
+                float maxObj = 0.f;
+                for (int b = 0; b < numAnchor; b++)
+                    maxObj = std::max(maxObj, values[4 * numAnchor + b]);
+                if (maxObj <= thresh)
+                    continue;
+
+                float cellMax = classes.cellMax(values + 5 * numAnchor);
+
                 for (int b = 0; b < numAnchor; b++)
                 {
                     int   cate = -1;
                     float sc   = -1.f;
-                    getCategory(values, b, cate, sc);
+                    getCategory(values, b, classes, cellMax, thresh, cate, sc);
 
-                    if (cate < 0 || sc <= thresh)
-                    {
+                    if (cate < 0)
                         continue;
-                    }
+
+                    float tw = values[b * 4 + 2] * 2.f;
+                    float th = values[b * 4 + 3] * 2.f;
 
                     float bcx = ((values[b * 4 + 0] * 2.f - 0.5f) + w) * stride;
                     float bcy = ((values[b * 4 + 1] * 2.f - 0.5f) + h) * stride;
-                    float bw  = std::pow(values[b * 4 + 2] * 2.f, 2.f) *
-                                anchor[i * numAnchor * 2 + b * 2 + 0];
-                    float bh  = std::pow(values[b * 4 + 3] * 2.f, 2.f) *
-                                anchor[i * numAnchor * 2 + b * 2 + 1];
+                    float bw  = tw * tw * anc[b * 2 + 0];
+                    float bh  = th * th * anc[b * 2 + 1];
 
                     TargetBox box;
                     box.x1   = (int)((bcx - 0.5f * bw) * scaleW);
@@ -203,48 +493,385 @@ int yoloFastestv2::predHandle(const ncnn::Mat* out,
                     box.score = sc;
                     box.cate  = cate;
 
-                    tmpBoxes.push_back(box);
+                    candidates.push_back(box);
                 }
-                values += outC;
             }
         }
     }
 
-    return nmsHandle(tmpBoxes, dstBoxes);
+    return 0;
+}
+ 
+//  forward() 
+int yoloFastestv2::forward(const ncnn::Mat& inputImg, ncnn::Mat* out)
+{
+    if (!extractor)
+        return -1;
+
+    ncnn::Extractor& ex = *extractor;
+    ex = *extractorProto;
+
+    ex.input("input.1", inputImg);
+
+    ex.extract("794", out[0]); // 22x22
+    ex.extract("796", out[1]); // 11x11
+    return 0;
 }
  
 //  detection() 
 int yoloFastestv2::detection(const cv::Mat& srcImg,
                              std::vector<TargetBox>& dstBoxes,
-                             float thresh)
+                             float thresh,
+                             const std::vector<int>& classes)
 {
     dstBoxes.clear();
-    if (srcImg.empty())
+
+    if (preprocess(srcImg, inputBuf) != 0)
         return -1;
 
-    float scaleW = (float)srcImg.cols / (float)inputWidth;
-    float scaleH = (float)srcImg.rows / (float)inputHeight;
+    return detection(inputBuf, srcImg.cols, srcImg.rows, dstBoxes, thresh, classes);
+}
 
-    ncnn::Mat inputImg = ncnn::Mat::from_pixels_resize(
-        srcImg.data,
-        ncnn::Mat::PIXEL_BGR,
-        srcImg.cols,
-        srcImg.rows,
-        inputWidth,
-        inputHeight);
+int yoloFastestv2::detection(const ncnn::Mat& inputImg, int srcW, int srcH,
+                             std::vector<TargetBox>& dstBoxes,
+                             float thresh,
+                             const std::vector<int>& classes)
+{
+    dstBoxes.clear();
+    if (inputImg.empty())
+        return -1;
 
-    const float mean_vals[3] = {0.f, 0.f, 0.f};
-    const float norm_vals[3] = {1.f / 255.f, 1.f / 255.f, 1.f / 255.f};
-    inputImg.substract_mean_normalize(mean_vals, norm_vals);
+    float scaleW = (float)srcW / (float)inputWidth;
+    float scaleH = (float)srcH / (float)inputHeight;
 
-    ncnn::Extractor ex = net.create_extractor(); 
+    if (forward(inputImg, outBuf) != 0)
+        return -1;
 
-    ex.input("input.1", inputImg);
+    if (predHandle(outBuf, candBoxes, scaleW, scaleH, thresh, classes) != 0)
+        return -1;
+    return nmsHandle(candBoxes, dstBoxes);
+}
 
-    ncnn::Mat out[2];
-    ex.extract("794", out[0]); // 22x22
-    ex.extract("796", out[1]); // 11x11
+int yoloFastestv2::detection(const cv::Mat& srcImg, const std::vector<cv::Rect>& tiles,
+                             std::vector<TargetBox>& dstBoxes,
+                             float thresh,
+                             const std::vector<int>& classes)
+{
+    dstBoxes.clear();
+
+    clipTiles(tiles, srcImg.cols, srcImg.rows, tileRects);
+    if (tileRects.empty())
+        return -1;
+    if (tileOut.size() < 2 * tileRects.size())
+        tileOut.resize(2 * tileRects.size());
+
+    candBoxes.clear();
+    for (size_t k = 0; k < tileRects.size(); k++)
+    {
+        if (preprocessTile(srcImg, tileRects[k], inputBuf) != 0 ||
+            forward(inputBuf, &tileOut[2 * k]) != 0)
+            return -1;
+        if (decodeTile(&tileOut[2 * k], tileRects[k], srcImg.cols, srcImg.rows,
+                       thresh, classes, candBoxes) != 0)
+            return -1;
+    }
+    return nmsHandle(candBoxes, dstBoxes);
+}
+ 
+//  tiles 
+
+// empty tiles = the whole frame; crops too small to resample are dropped
+void yoloFastestv2::clipTiles(const std::vector<cv::Rect>& tiles, int srcW, int srcH,
+                              std::vector<cv::Rect>& clipped) const
+{
+    const cv::Rect frame(0, 0, srcW, srcH);
+    clipped.clear();
+    if (tiles.empty())
+    {
+        clipped.push_back(frame);
+        return;
+    }
+    for (size_t k = 0; k < tiles.size(); k++)
+    {
+        cv::Rect r = tiles[k] & frame;
+        if (r.width >= 2 && r.height >= 2)
+            clipped.push_back(r);
+    }
+}
+
+// The whole frame is squashed to the model input as usual. A crop keeps its
+// aspect ratio: its own size, scaled down to fit the model input if larger,
+// rounded to the 32 px the heads need.
+void yoloFastestv2::tileInputSize(const cv::Rect& tile, int srcW, int srcH,
+                                  int& netW, int& netH) const
+{
+    if (tile.width == srcW && tile.height == srcH)
+    {
+        netW = inputWidth;
+        netH = inputHeight;
+        return;
+    }
+    float s = std::min(1.f, std::min((float)inputWidth / tile.width,
+                                     (float)inputHeight / tile.height));
+    netW = std::max(32, (int)std::lround(tile.width  * s / 32.f) * 32);
+    netH = std::max(32, (int)std::lround(tile.height * s / 32.f) * 32);
+}
+
+int yoloFastestv2::preprocessTile(const cv::Mat& srcImg, const cv::Rect& tile,
+                                  ncnn::Mat& inputImg)
+{
+    int netW, netH;
+    tileInputSize(tile, srcImg.cols, srcImg.rows, netW, netH);
+    return preprocessTo(srcImg(tile), netW, netH, inputImg);   // ROI header, no copy
+}
+
+// appends the tile's candidates in frame coordinates
+int yoloFastestv2::decodeTile(const ncnn::Mat* out, const cv::Rect& tile, int srcW, int srcH,
+                              float thresh, const std::vector<int>& classes,
+                              std::vector<TargetBox>& candidates)
+{
+    int netW, netH;
+    tileInputSize(tile, srcW, srcH, netW, netH);
+    const float scaleW = (float)tile.width  / (float)netW;
+    const float scaleH = (float)tile.height / (float)netH;
+
+    // single whole-frame tile: decode in place
+    if (candidates.empty() && tile.x == 0 && tile.y == 0)
+        return predHandle(out, candidates, scaleW, scaleH, thresh, classes);
+
+    if (predHandle(out, tileBoxes, scaleW, scaleH, thresh, classes) != 0)
+        return -1;
+    for (size_t i = 0; i < tileBoxes.size(); i++)
+    {
+        TargetBox b = tileBoxes[i];
+        b.x1 += tile.x;
+        b.x2 += tile.x;
+        b.y1 += tile.y;
+        b.y2 += tile.y;
+        candidates.push_back(b);
+    }
+    return 0;
+}
+ 
+//  async pipeline 
+// Jobs live in a fixed ring; each stage walks the ring in submission order
+// and waits for the next job to reach its state, so order is preserved and
+// every stage owns the job it is working on. Each detector member used by
+// a stage (resize tables / extractor / tile decode buffer + NMS engine) is
+// touched by that stage's thread only.
+
+namespace {
+
+enum JobState { JOB_FREE, JOB_PP, JOB_INFER, JOB_POST, JOB_DONE };
+
+struct AsyncJob
+{
+    JobState               state  = JOB_FREE;
+    uint64_t               handle = 0;
+    cv::Mat                src;
+    int                    srcW   = 0;
+    int                    srcH   = 0;
+    std::vector<cv::Rect>  tiles;    // clipped, at least one
+    std::vector<ncnn::Mat> inputs;   // per tile
+    std::vector<ncnn::Mat> outs;     // 2 per tile
+    std::vector<TargetBox> candidates;
+    AsyncResult            result;
+    AsyncCallback          cb;
+};
+
+} // namespace
+
+struct yoloFastestv2::AsyncPipeline
+{
+    float            thresh;
+    std::vector<int> classes;
+
+    std::vector<AsyncJob>   jobs;
+    uint64_t                nextSeq = 0;
+    bool                    running = false;
+    std::mutex              mtx;
+    std::condition_variable cv;
+    std::thread             stages[3];
 
-    predHandle(out, dstBoxes, scaleW, scaleH, thresh);
+    AsyncJob& job(uint64_t seq) { return jobs[seq % jobs.size()]; }
+};
+
+int yoloFastestv2::startAsync(int depth, float thresh, const std::vector<int>& classes)
+{
+    if (async && async->running)
+        return -1;
+    if (!extractor)
+        return -1;
+
+    async.reset(new AsyncPipeline());
+    async->thresh  = thresh;
+    async->classes = classes;
+    async->jobs.resize(std::max(depth, 1));
+    for (size_t i = 0; i < async->jobs.size(); i++)
+        async->jobs[i].candidates.reserve(candBoxes.capacity());
+    async->running = true;
+
+    for (int i = 0; i < 3; i++)
+        async->stages[i] = std::thread(&yoloFastestv2::asyncStage, this, i);
     return 0;
-}
\ No newline at end of file
+}
+
+void yoloFastestv2::stopAsync()
+{
+    if (!async)
+        return;
+    {
+        std::lock_guard<std::mutex> lk(async->mtx);
+        async->running = false;
+    }
+    async->cv.notify_all();
+    for (int i = 0; i < 3; i++)
+    {
+        if (async->stages[i].joinable())
+            async->stages[i].join();
+    }
+    // the pipeline itself stays until the destructor (or the next
+    // startAsync()): another thread may still be inside submit()/wait(),
+    // where it now sees running == false and returns
+}
+
+uint64_t yoloFastestv2::submit(const cv::Mat& srcImg, AsyncCallback cb)
+{
+    static const std::vector<cv::Rect> wholeFrame;
+    return submit(srcImg, wholeFrame, std::move(cb));
+}
+
+uint64_t yoloFastestv2::submit(const cv::Mat& srcImg, const std::vector<cv::Rect>& tiles,
+                               AsyncCallback cb)
+{
+    if (!async)
+        return 0;
+
+    AsyncPipeline& p = *async;
+    std::unique_lock<std::mutex> lk(p.mtx);
+    p.cv.wait(lk, [&p] { return !p.running || p.job(p.nextSeq).state == JOB_FREE; });
+    if (!p.running)
+        return 0;
+
+    uint64_t  seq = p.nextSeq++;
+    AsyncJob& j   = p.job(seq);
+    j.handle = seq + 1;
+    j.src    = srcImg;
+    j.srcW   = srcImg.cols;
+    j.srcH   = srcImg.rows;
+    clipTiles(tiles, j.srcW, j.srcH, j.tiles);
+    j.cb     = std::move(cb);
+    j.state  = JOB_PP;
+    lk.unlock();
+    p.cv.notify_all();
+    return seq + 1;
+}
+
+bool yoloFastestv2::poll(uint64_t handle, AsyncResult& result)
+{
+    if (!async || handle == 0)
+        return false;
+
+    AsyncPipeline& p = *async;
+    std::unique_lock<std::mutex> lk(p.mtx);
+    AsyncJob& j = p.job(handle - 1);
+    if (j.handle != handle || j.state != JOB_DONE)
+        return false;
+
+    result.status    = j.result.status;
+    result.t_pp_s    = j.result.t_pp_s;
+    result.t_pp      = j.result.t_pp;
+    result.t_infer_s = j.result.t_infer_s;
+    result.t_infer_e = j.result.t_infer_e;
+    result.t_done    = j.result.t_done;
+    result.boxes.swap(j.result.boxes);
+    j.state = JOB_FREE;
+    lk.unlock();
+    p.cv.notify_all();
+    return true;
+}
+
+bool yoloFastestv2::wait(uint64_t handle, AsyncResult& result)
+{
+    if (!async || handle == 0)
+        return false;
+
+    AsyncPipeline& p = *async;
+    {
+        std::unique_lock<std::mutex> lk(p.mtx);
+        AsyncJob& j = p.job(handle - 1);
+        p.cv.wait(lk, [&p, &j, handle] {
+            return !p.running || j.handle != handle ||
+                   j.state == JOB_DONE || j.state == JOB_FREE;
+        });
+    }
+    return poll(handle, result);
+}
+
+void yoloFastestv2::asyncStage(int stage)
+{
+    static const JobState waitFor[3] = { JOB_PP, JOB_INFER, JOB_POST };
+
+    AsyncPipeline& p = *async;
+    for (uint64_t seq = 0; ; seq++)
+    {
+        AsyncJob& j = p.job(seq);
+        {
+            std::unique_lock<std::mutex> lk(p.mtx);
+            p.cv.wait(lk, [&p, &j, seq, stage] {
+                return !p.running || (j.handle == seq + 1 && j.state == waitFor[stage]);
+            });
+            if (!p.running)
+                break;
+        }
+
+        JobState next = JOB_DONE;
+        const size_t numTiles = j.tiles.size();
+        if (stage == 0)
+        {
+            j.result.t_pp_s = std::chrono::steady_clock::now();
+            if (j.inputs.size() < numTiles)
+                j.inputs.resize(numTiles);
+            j.result.status = numTiles ? 0 : -1;
+            for (size_t k = 0; k < numTiles && j.result.status == 0; k++)
+                j.result.status = preprocessTile(j.src, j.tiles[k], j.inputs[k]);
+            j.result.t_pp   = std::chrono::steady_clock::now();
+            j.src.release();   // pixels no longer needed
+            next = JOB_INFER;
+        }
+        else if (stage == 1)
+        {
+            j.result.t_infer_s = std::chrono::steady_clock::now();
+            if (j.outs.size() < 2 * numTiles)
+                j.outs.resize(2 * numTiles);
+            for (size_t k = 0; k < numTiles && j.result.status == 0; k++)
+                j.result.status = forward(j.inputs[k], &j.outs[2 * k]);
+            j.result.t_infer_e = std::chrono::steady_clock::now();
+            next = JOB_POST;
+        }
+        else
+        {
+            j.result.boxes.clear();
+            j.candidates.clear();
+            for (size_t k = 0; k < numTiles && j.result.status == 0; k++)
+                j.result.status = decodeTile(&j.outs[2 * k], j.tiles[k], j.srcW, j.srcH,
+                                             p.thresh, p.classes, j.candidates);
+            if (j.result.status == 0)
+                nmsHandle(j.candidates, j.result.boxes);   // merges across tiles
+            j.result.t_done = std::chrono::steady_clock::now();
+
+            if (j.cb)
+            {
+                j.cb(j.handle, j.result);
+                j.cb = AsyncCallback();
+                next = JOB_FREE;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(p.mtx);
+            j.state = next;
+        }
+        p.cv.notify_all();
+    }
+}
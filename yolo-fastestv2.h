@@ -1,10 +1,16 @@
 #ifndef YOLO_FASTESTV2_H
 #define YOLO_FASTESTV2_H
 
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <opencv2/opencv.hpp>
 #include <net.h>   // từ ncnn
 
+#include "nms.hpp"
+
 class TargetBox
 {
 private:
@@ -22,12 +28,39 @@ public:
     float area() const { return getWidth() * getHeight(); }
 };
  
+//  async results 
+struct AsyncResult
+{
+    int                    status = 0;   // 0 ok, -1 preprocess/inference failed
+    std::vector<TargetBox> boxes;
+
+    std::chrono::steady_clock::time_point t_pp_s;      // preprocess started
+    std::chrono::steady_clock::time_point t_pp;        // preprocess done
+    std::chrono::steady_clock::time_point t_infer_s;   // inference started
+    std::chrono::steady_clock::time_point t_infer_e;   // inference done, decode started
+    std::chrono::steady_clock::time_point t_done;      // decode + NMS done
+};
+
+// runs on the decode stage thread; may swap result.boxes out
+typedef std::function<void(uint64_t handle, AsyncResult& result)> AsyncCallback;
+ 
 //  yoloFastestv2 
 
+// One detector = one inference workspace: detection()/forward() reuse the
+// same extractor and buffers, so a detector must not be used from two
+// threads at once. After the first call preprocess (no cv::resize temporaries),
+// decode and NMS run on the detector's own buffers and blobs come from its
+// pools; ncnn's forward still does a few small allocations per run
+// (bench_alloc counts them).
+// Several detectors can share one loaded model through shareModel().
 class yoloFastestv2
 {
 private:
-    ncnn::Net          net;
+    // pools outlive the extractor and buffers below, which draw from them
+    ncnn::UnlockedPoolAllocator blobPool;
+    ncnn::PoolAllocator         workspacePool;
+
+    std::shared_ptr<ncnn::Net> net;   // weights, shared between detectors
     std::vector<float> anchor;
 
     int   numAnchor;
@@ -38,14 +71,55 @@ private:
     int   inputHeight;
     float nmsThresh;
 
-    int nmsHandle(std::vector<TargetBox>& tmpBoxes,
-                  std::vector<TargetBox>& dstBoxes);
+    // preprocess tables, rebuilt when the source or input size changes
+    int                ppSrcW;
+    int                ppSrcH;
+    int                ppDstW;
+    int                ppDstH;
+    std::vector<int>   ppXofs;   // byte offset of left neighbour, per output column
+    std::vector<float> ppAlpha;  // weight of right neighbour, per output column
+    std::vector<int>   ppYofs;   // top source row, per output row
+    std::vector<float> ppBeta;   // weight of bottom row, per output row
+    std::vector<float> ppRow;    // one vertically blended source row (srcW * 3)
+
+    void buildResizeTables(int srcW, int srcH, int dstW, int dstH);
+    void createExtractor();
+    int  preprocessTo(const cv::Mat& srcImg, int dstW, int dstH, ncnn::Mat& inputImg);
+
+    // tiled detection helpers, tiles already clipped to the frame
+    void clipTiles(const std::vector<cv::Rect>& tiles, int srcW, int srcH,
+                   std::vector<cv::Rect>& clipped) const;
+    void tileInputSize(const cv::Rect& tile, int srcW, int srcH, int& netW, int& netH) const;
+    int  preprocessTile(const cv::Mat& srcImg, const cv::Rect& tile, ncnn::Mat& inputImg);
+    int  decodeTile(const ncnn::Mat* out, const cv::Rect& tile, int srcW, int srcH,
+                    float thresh, const std::vector<int>& classes,
+                    std::vector<TargetBox>& candidates);
+
+    struct AsyncPipeline;
+    std::unique_ptr<AsyncPipeline> async;
+    void asyncStage(int stage);
+
+    // inference workspace, recycled between detection() calls
+    std::unique_ptr<ncnn::Extractor> extractorProto;
+    std::unique_ptr<ncnn::Extractor> extractor;
+    ncnn::Mat                        inputBuf;
+    ncnn::Mat                        outBuf[2];
+    std::vector<TargetBox>           candBoxes;   // decode output
+    std::vector<TargetBox>           tileBoxes;   // one tile's decode output (decode stage)
+    std::vector<cv::Rect>            tileRects;   // clipped tiles of the synchronous path
+    std::vector<ncnn::Mat>           tileOut;     // 2 maps per tile, synchronous path
+    NmsEngine                        nms;
+
+    template <class ClassSet>
     int getCategory(const float* values, int index,
-                    int& category, float& score);
-    int predHandle(const ncnn::Mat* out,
-                   std::vector<TargetBox>& dstBoxes,
-                   float scaleW, float scaleH,
-                   float thresh);
+                    const ClassSet& classes, float cellMax,
+                    float thresh, int& category, float& score);
+    template <class ClassSet>
+    int decodeHeads(const ncnn::Mat* out,
+                    std::vector<TargetBox>& candidates,
+                    float scaleW, float scaleH,
+                    float thresh,
+                    const ClassSet& classes);
 
 public:
     yoloFastestv2();
@@ -53,9 +127,74 @@ public:
 
     int init(bool use_vulkan_compute = false);
     int loadModel(const char* paramPath, const char* binPath);
+    // run on the weights (and options) other has already loaded
+    int shareModel(const yoloFastestv2& other);
+    // ncnn threads used by this detector's inferences (default 4)
+    void setNumThreads(int threads);
+
+    // Bilinear resize of a BGR8 frame of any size to the network input and
+    // scale to [0,1], written straight into ncnn's planar float layout.
+    // One pass over the source, no intermediate cv::Mat.
+    int preprocess(const cv::Mat& srcImg, ncnn::Mat& inputImg);
+
+    // pipeline stages used by detection(), public for benchmarking
+    int forward(const ncnn::Mat& inputImg, ncnn::Mat* out);
+    int predHandle(const ncnn::Mat* out,
+                   std::vector<TargetBox>& candidates,
+                   float scaleW, float scaleH,
+                   float thresh,
+                   const std::vector<int>& classes = std::vector<int>());
+    int nmsHandle(std::vector<TargetBox>& tmpBoxes,
+                  std::vector<TargetBox>& dstBoxes);
+
+    // hard NMS with nmsThresh by default; Soft-NMS / top-K on request
+    void setNmsConfig(const NmsConfig& cfg);
+
+    // srcImg may be the raw camera frame; boxes come back in its coordinates.
+    // classes: allow-list of class ids, empty = all. Each anchor is labelled
+    // with its best allowed class, other classes are never decoded; a single
+    // id (e.g. {0} for person) reads just that class channel.
     int detection(const cv::Mat& srcImg,
                   std::vector<TargetBox>& dstBoxes,
-                  float thresh = 0.3f);
+                  float thresh = 0.3f,
+                  const std::vector<int>& classes = std::vector<int>());
+    // inputImg from preprocess(); srcW/srcH give the frame boxes are mapped to
+    int detection(const ncnn::Mat& inputImg, int srcW, int srcH,
+                  std::vector<TargetBox>& dstBoxes,
+                  float thresh = 0.3f,
+                  const std::vector<int>& classes = std::vector<int>());
+    // Tiled detection: one inference per crop (frame coordinates, clipped
+    // to the frame), boxes mapped back to the frame and merged by a single
+    // NMS pass over all tiles. A crop keeps its aspect ratio and runs at its
+    // own size rounded to 32, capped to the model input, so small crops cost
+    // fewer FLOPs; a crop covering the whole frame runs like detection().
+    // Empty tiles = whole frame.
+    int detection(const cv::Mat& srcImg, const std::vector<cv::Rect>& tiles,
+                  std::vector<TargetBox>& dstBoxes,
+                  float thresh = 0.3f,
+                  const std::vector<int>& classes = std::vector<int>());
+
+    // Async API. Preprocess, inference and decode+NMS run as three stages
+    // on their own threads, linked by a ring of `depth` in-flight jobs, so
+    // frame N+1 is preprocessed and N-1 decoded while N is in ncnn.
+    // Don't call detection() while the pipeline is running.
+    int  startAsync(int depth = 3, float thresh = 0.3f,
+                    const std::vector<int>& classes = std::vector<int>());
+    // pending jobs are dropped without callback; submit()/wait() callers
+    // blocked on other threads return 0/false. Don't restart with
+    // startAsync() while such calls may still be running.
+    void stopAsync();
+
+    // Blocks while the ring is full. srcImg is read on the preprocess
+    // thread: keep its pixels unchanged until the result is delivered.
+    // Returns a handle, 0 if the pipeline is not running. With a callback
+    // the result is delivered there; otherwise fetch it with poll()/wait().
+    uint64_t submit(const cv::Mat& srcImg, AsyncCallback cb = AsyncCallback());
+    // tiled variant, see detection(srcImg, tiles, ...)
+    uint64_t submit(const cv::Mat& srcImg, const std::vector<cv::Rect>& tiles,
+                    AsyncCallback cb = AsyncCallback());
+    bool     poll(uint64_t handle, AsyncResult& result);   // false if not done yet
+    bool     wait(uint64_t handle, AsyncResult& result);   // false if stopped
 };
 
 #endif  
\ No newline at end of file